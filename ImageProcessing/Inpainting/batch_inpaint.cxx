@@ -0,0 +1,397 @@
+// Headless batch inpainting
+//
+// usage: batch_inpaint [options] manifest
+//	-j threads	number of worker threads (default: number of hardware threads)
+//	-m mb		memory cap of the running jobs and loaded images, in megabytes (default: 1024); a soft limit, see below
+//	-w radius	patch radius (default: 4)
+//	-e engine	exhaustive, patchmatch, bounded or kdtree (default: exhaustive)
+//	-q quality	quality knob of the patchmatch engine (default: 4)
+//	-r radius	search radius of the bounded engine (default: 32)
+//	-t file		write the per-job timing report to file instead of stdout
+//
+// Every non-empty manifest line that does not start with '#' describes a job as "image mask output". A mask pixel
+// is unfilled if its first plane is non-zero. Jobs are run concurrently by a pool of worker threads. A job only
+// starts, and a source image is only loaded, if the estimated memory of the running jobs and of the loaded source
+// images and databases stays below the cap. The cap is soft: the memory is estimated, not measured, and a job or
+// an image always proceeds when no job is running, whatever its size, so that the batch cannot stall.
+//
+// Jobs that share a source image are grouped: the image is loaded once and, for the engines that search a
+// compact_patch_db, a single database is built from the patches that are full under the union of the masks of the
+// group. It is immutable and shared by all the jobs of the group, and freed with the image when the last of them
+// completes. The shared database holds fewer patches than a database built for one mask, so a job may find a
+// slightly different match than a standalone run; groups of one job use their own database.
+
+#include "inpaint_exemplar.h"
+#include "compact_patch_db.h"
+#include "patch_ssd.h"
+#include "inpaint_io.h"
+#include <vcl_iostream.h>
+#include <vcl_fstream.h>
+#include <vcl_sstream.h>
+#include <vcl_string.h>
+#include <vcl_vector.h>
+#include <vcl_map.h>
+#include <vcl_cstdlib.h>
+#include <vcl_cstring.h>
+#include <vcl_algorithm.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// rough memory of one inpaint_exemplar() run per image pixel, not counting the patch database: the working copy
+// of the image and its gray version, masks, confidences and their Fenwick tree, gradients, normals, heap positions
+static const vcl_size_t job_bytes_per_pixel = 96;
+
+// engines that search a compact_patch_db, which can be shared
+static bool searches_db(inpaint_engine engine)
+{
+	return (engine == INPAINT_EXHAUSTIVE) || (engine == INPAINT_BOUNDED);
+}
+
+struct batch_job {
+	vcl_string image, mask, output;
+	int group;
+
+	vil_image_view<bool> unfilled;
+
+	bool ok;
+	vcl_string error;
+	double t_prepare, t_wait, t_inpaint, t_save;
+};
+
+struct batch_group {
+	vcl_vector<int> jobs;
+	int pending;
+
+	std::mutex lock;
+	bool prepared;
+	bool failed;
+	vil_image_view<vil_rgb<vxl_byte> > im;
+	compact_patch_db* db;
+	vcl_size_t bytes;
+};
+
+struct batch_state {
+	inpaint_params params;
+	vcl_vector<batch_job> jobs;
+	vcl_vector<batch_group*> groups;
+
+	std::mutex lock;
+	std::condition_variable released;
+	int next;
+	int running;
+	vcl_size_t cap, used;
+};
+
+static double seconds_since(const std::chrono::steady_clock::time_point& t0)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// reserves bytes of the memory cap for a job, or for a group if job is false, waiting for running jobs to complete
+// if needed. Only running jobs release memory, so nothing waits when none is running.
+static void acquire(batch_state& state, vcl_size_t bytes, bool job)
+{
+	std::unique_lock<std::mutex> guard(state.lock);
+
+	while ((state.running > 0) && (state.used + bytes > state.cap))
+		state.released.wait(guard);
+	state.used += bytes;
+	if (job)
+		state.running++;
+}
+
+static void release(batch_state& state, vcl_size_t bytes, bool job)
+{
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.used -= bytes;
+		if (job)
+			state.running--;
+	}
+	state.released.notify_all();
+}
+
+// loads the source image and the masks of a group and builds its shared database; called by the first worker that
+// reaches one of its jobs, with the group locked
+static bool prepare_group(batch_state& state, batch_group& g)
+{
+	int n, i, j, ni, nj;
+	bool shared = searches_db(state.params.engine) && (g.jobs.size() > 1);
+
+// the group stays in memory until its last job completes, so its memory is reserved before anything is loaded:
+// the image and its decoded copy, the masks and, for a shared database, at most one patch per pixel with its
+// center and grid entry plus the union mask and its summed-area table
+	if (!image_size(state.jobs[g.jobs[0]].image, ni, nj)) {
+		for (n=0; n < (int) g.jobs.size(); n++)
+			state.jobs[g.jobs[n]].error = "cannot read image";
+		return false;
+	}
+	vcl_size_t reserved = (vcl_size_t) ni * nj * (2*sizeof(vil_rgb<vxl_byte>) + g.jobs.size() * sizeof(bool));
+	if (shared)
+		reserved += (vcl_size_t) ni * nj * (packed_patch::bytes(state.params.w, 3, PATCH_INTERLEAVED) +
+											3*sizeof(int) + sizeof(bool) + sizeof(int));
+	acquire(state, reserved, false);
+
+	if (!load_rgb(state.jobs[g.jobs[0]].image, g.im) || ((int) g.im.ni() != ni) || ((int) g.im.nj() != nj)) {
+		for (n=0; n < (int) g.jobs.size(); n++)
+			state.jobs[g.jobs[n]].error = "cannot read image";
+		release(state, reserved, false);
+		return false;
+	}
+
+	vil_image_view<bool> all;
+	if (shared) {
+		all.set_size(ni, nj);
+		all.fill(false);
+	}
+	for (n=0; n < (int) g.jobs.size(); n++) {
+		batch_job& job = state.jobs[g.jobs[n]];
+
+		if (!load_mask(job.mask, ni, nj, job.unfilled)) {
+			job.error = "cannot read mask or size mismatch";
+			continue;
+		}
+		if (shared)
+			for (j=0; j < nj; j++)
+				for (i=0; i < ni; i++)
+					if (job.unfilled(i, j))
+						all(i, j) = true;
+	}
+
+	g.bytes = (vcl_size_t) ni * nj * (sizeof(vil_rgb<vxl_byte>) + g.jobs.size() * sizeof(bool));
+	if (shared) {
+		g.db = new compact_patch_db(g.im, all, state.params.w);
+		if (state.params.engine == INPAINT_BOUNDED)
+			g.db->build_grid(state.params.search_radius);
+		g.bytes += g.db->footprint();
+	}
+
+// keep only what the group actually holds charged to the cap
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.used = state.used - reserved + g.bytes;
+	}
+	state.released.notify_all();
+	return true;
+}
+
+static void run_job(batch_state& state, int n)
+{
+	batch_job& job = state.jobs[n];
+	batch_group& g = *state.groups[job.group];
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+	job.ok = false;
+	{
+		std::lock_guard<std::mutex> guard(g.lock);
+		if (!g.prepared) {
+			g.failed = !prepare_group(state, g);
+			g.prepared = true;
+		}
+	}
+	job.t_prepare = seconds_since(t0);
+
+	if (!g.failed && job.error.empty()) {
+		vcl_size_t bytes = (vcl_size_t) g.im.ni() * g.im.nj() * job_bytes_per_pixel;
+		if (!g.db && searches_db(state.params.engine))
+			bytes += (vcl_size_t) g.im.ni() * g.im.nj() *
+					 packed_patch::bytes(state.params.w, 3, PATCH_INTERLEAVED);
+		else if (state.params.engine == INPAINT_KDTREE)
+			bytes += (vcl_size_t) g.im.ni() * g.im.nj() *
+					 (sizeof(vil_rgb<vxl_byte>) + 4*sizeof(int) + state.params.index_dims * sizeof(float));
+
+		t0 = std::chrono::steady_clock::now();
+		acquire(state, bytes, true);
+		job.t_wait = seconds_since(t0);
+
+		inpaint_params params = state.params;
+		params.db = g.db;
+
+		vil_image_view<vil_rgb<vxl_byte> > result;
+		t0 = std::chrono::steady_clock::now();
+		job.ok = inpaint_exemplar(g.im, job.unfilled, params, result);
+		job.t_inpaint = seconds_since(t0);
+
+		release(state, bytes, true);
+
+		if (!job.ok)
+			job.error = "inpainting failed";
+		else {
+			t0 = std::chrono::steady_clock::now();
+			job.ok = save_rgb(job.output, result);
+			job.t_save = seconds_since(t0);
+			if (!job.ok)
+				job.error = "cannot write output";
+		}
+	}
+	job.unfilled = vil_image_view<bool>();
+
+// the last job of a group frees the image and the shared database
+	bool last;
+	{
+		std::lock_guard<std::mutex> guard(g.lock);
+		last = (--g.pending == 0);
+	}
+	if (last) {
+		delete g.db;
+		g.db = 0;
+		g.im = vil_image_view<vil_rgb<vxl_byte> >();
+		release(state, g.bytes, false);
+	}
+}
+
+static void worker(batch_state* state)
+{
+	for (;;) {
+		int n;
+		{
+			std::lock_guard<std::mutex> guard(state->lock);
+			if (state->next == (int) state->jobs.size())
+				return;
+			n = state->next++;
+		}
+		run_job(*state, n);
+	}
+}
+
+// reads the jobs of the manifest, sorted so that the jobs of a group are consecutive
+static bool read_manifest(const char* fname, batch_state& state)
+{
+	vcl_ifstream in(fname);
+	vcl_string line;
+	vcl_map<vcl_string, int> group_of;
+	vcl_vector<batch_job> jobs;
+	int n, k;
+
+	if (!in)
+		return false;
+
+	while (vcl_getline(in, line)) {
+		vcl_istringstream fields(line);
+		batch_job job;
+
+		if (!(fields >> job.image) || (job.image[0] == '#'))
+			continue;
+		if (!(fields >> job.mask >> job.output)) {
+			vcl_cerr << "batch_inpaint: malformed manifest line: " << line << "\n";
+			return false;
+		}
+		job.ok = false;
+		job.t_prepare = job.t_wait = job.t_inpaint = job.t_save = 0;
+
+		if (group_of.find(job.image) == group_of.end()) {
+			group_of[job.image] = state.groups.size();
+			batch_group* g = new batch_group;
+			g->pending = 0;
+			g->prepared = g->failed = false;
+			g->db = 0;
+			g->bytes = 0;
+			state.groups.push_back(g);
+		}
+		job.group = group_of[job.image];
+		jobs.push_back(job);
+	}
+
+	for (k=0; k < (int) state.groups.size(); k++)
+		for (n=0; n < (int) jobs.size(); n++)
+			if (jobs[n].group == k) {
+				state.groups[k]->jobs.push_back(state.jobs.size());
+				state.groups[k]->pending++;
+				state.jobs.push_back(jobs[n]);
+			}
+	return true;
+}
+
+static int usage()
+{
+	vcl_cerr << "usage: batch_inpaint [-j threads] [-m mb] [-w radius] [-e exhaustive|patchmatch|bounded|kdtree]\n"
+			 << "                     [-q quality] [-r radius] [-t timing_file] manifest\n";
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	batch_state state;
+	int threads = std::thread::hardware_concurrency();
+	double mb = 1024;
+	const char* timing_fname = 0;
+	int a, n;
+
+	for (a=1; a < argc - 1; a += 2) {
+		if (!vcl_strcmp(argv[a], "-j"))
+			threads = vcl_atoi(argv[a+1]);
+		else if (!vcl_strcmp(argv[a], "-m"))
+			mb = vcl_atof(argv[a+1]);
+		else if (!vcl_strcmp(argv[a], "-w"))
+			state.params.w = vcl_atoi(argv[a+1]);
+		else if (!vcl_strcmp(argv[a], "-q"))
+			state.params.quality = vcl_atoi(argv[a+1]);
+		else if (!vcl_strcmp(argv[a], "-r"))
+			state.params.search_radius = vcl_atoi(argv[a+1]);
+		else if (!vcl_strcmp(argv[a], "-t"))
+			timing_fname = argv[a+1];
+		else if (!vcl_strcmp(argv[a], "-e")) {
+			if (!vcl_strcmp(argv[a+1], "exhaustive"))
+				state.params.engine = INPAINT_EXHAUSTIVE;
+			else if (!vcl_strcmp(argv[a+1], "patchmatch"))
+				state.params.engine = INPAINT_PATCHMATCH;
+			else if (!vcl_strcmp(argv[a+1], "bounded"))
+				state.params.engine = INPAINT_BOUNDED;
+			else if (!vcl_strcmp(argv[a+1], "kdtree"))
+				state.params.engine = INPAINT_KDTREE;
+			else
+				return usage();
+		} else
+			return usage();
+	}
+	if (a != argc - 1)
+		return usage();
+
+	if (!read_manifest(argv[a], state)) {
+		vcl_cerr << "batch_inpaint: cannot read manifest " << argv[a] << "\n";
+		return 1;
+	}
+
+	state.next = 0;
+	state.running = 0;
+	state.used = 0;
+	state.cap = (vcl_size_t) (mb * 1024 * 1024);
+	threads = vcl_max(1, vcl_min(threads, (int) state.jobs.size()));
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	vcl_vector<std::thread> pool;
+	for (n=0; n < threads; n++)
+		pool.push_back(std::thread(worker, &state));
+	for (n=0; n < threads; n++)
+		pool[n].join();
+	double total = seconds_since(t0);
+
+// per-job report: times in seconds; prepare includes loading the group and building its database when this job
+// was the first of its group to run, wait is the time spent waiting for memory
+	vcl_ofstream file;
+	if (timing_fname)
+		file.open(timing_fname);
+	vcl_ostream& out = timing_fname ? (vcl_ostream&) file : vcl_cout;
+
+	int failed = 0;
+	out << "# output status prepare wait inpaint save\n";
+	for (n=0; n < (int) state.jobs.size(); n++) {
+		const batch_job& job = state.jobs[n];
+
+		out << job.output << " " << (job.ok ? "ok" : "failed") << " "
+			<< job.t_prepare << " " << job.t_wait << " " << job.t_inpaint << " " << job.t_save << "\n";
+		if (!job.ok) {
+			vcl_cerr << "batch_inpaint: " << job.output << ": " << job.error << "\n";
+			failed++;
+		}
+	}
+	out << "# " << state.jobs.size() << " jobs, " << failed << " failed, " << threads << " threads, "
+		<< total << " s\n";
+
+	for (n=0; n < (int) state.groups.size(); n++)
+		delete state.groups[n];
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,274 @@
+#include "compact_patch_db.h"
+#include "mask_sat.h"
+#include <vcl_cstring.h>
+#include <vcl_algorithm.h>
+#include <vcl_cstdlib.h>
+
+compact_patch_db::compact_patch_db(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			vil_image_view<bool> unfilled, int patch_radius,
+			patch_layout layout
+			)
+{
+	int n;
+
+	w_ = patch_radius;
+	nplanes_ = 3;
+	ni_ = im.ni();
+	nj_ = im.nj();
+	layout_ = layout;
+	patch_bytes_ = packed_patch::bytes(w_, nplanes_, layout_);
+	stride_ = packed_patch::stride(w_, nplanes_, layout_);
+	capacity_ = 0;
+	cell_ = 0;
+	grid_ni_ = grid_nj_ = 0;
+
+// find the full patches first, so that the buffer is allocated exactly once
+	compute_patch_centers(unfilled);
+
+	vcl_vector<int> centers;
+	centers.swap(centers_);
+	reserve_patches((int) centers.size() / 2);
+	for (n=0; n < (int) centers.size(); n += 2)
+		append_patch(im, centers[n], centers[n+1]);
+}
+
+void compact_patch_db::compute_patch_centers(vil_image_view<bool> uf)
+{
+	centers_.clear();
+	full_patch_centers(uf, w_, centers_);
+}
+
+vxl_byte* compact_patch_db::patches()
+{
+	vcl_size_t addr = (vcl_size_t) &buffer_[0];
+
+	return &buffer_[0] + ((32 - (addr & 31)) & 31);
+}
+
+const vxl_byte* compact_patch_db::patches() const
+{
+	vcl_size_t addr = (vcl_size_t) &buffer_[0];
+
+	return &buffer_[0] + ((32 - (addr & 31)) & 31);
+}
+
+void compact_patch_db::reserve_patches(int n)
+{
+	if (n <= capacity_)
+		return;
+
+// a reallocated vector is not necessarily aligned the same way, so the patches are moved explicitly
+	vcl_vector<vxl_byte> old;
+	const vxl_byte* old_patches = 0;
+	if (capacity_ > 0) {
+		old.swap(buffer_);
+		vcl_size_t addr = (vcl_size_t) &old[0];
+		old_patches = &old[0] + ((32 - (addr & 31)) & 31);
+	}
+
+	buffer_.assign((vcl_size_t) n * patch_bytes_ + 31, 0);
+	if (old_patches)
+		vcl_memcpy(patches(), old_patches, (vcl_size_t) size() * patch_bytes_);
+	capacity_ = n;
+}
+
+void compact_patch_db::append_patch(const vil_image_view<vil_rgb<vxl_byte> >& im, int i, int j)
+{
+	int pi, pj;
+	int sz = 2*w_ + 1;
+
+	if (size() == capacity_)
+		reserve_patches(2*capacity_ + 1);
+
+	vxl_byte* p = patches() + (vcl_size_t) size() * patch_bytes_;
+
+	for (pj= -w_; pj <= w_; pj++)
+		for (pi= -w_; pi <= w_; pi++) {
+			const vil_rgb<vxl_byte>& v = im(i+pi, j+pj);
+
+			if (layout_ == PATCH_INTERLEAVED) {
+				vxl_byte* row = p + (w_+pj)*stride_ + nplanes_*(w_+pi);
+				row[0] = v.r;
+				row[1] = v.g;
+				row[2] = v.b;
+			} else {
+				p[(0*sz + w_+pj)*stride_ + w_+pi] = v.r;
+				p[(1*sz + w_+pj)*stride_ + w_+pi] = v.g;
+				p[(2*sz + w_+pj)*stride_ + w_+pi] = v.b;
+			}
+		}
+
+	centers_.push_back(i);
+	centers_.push_back(j);
+
+	if (cell_ > 0)
+		grid_[(i / cell_) + (j / cell_) * grid_ni_].push_back(size() - 1);
+}
+
+void compact_patch_db::build_grid(int cell)
+{
+	int n;
+
+	cell_ = vcl_max(1, cell);
+	grid_ni_ = (ni_ + cell_ - 1) / cell_;
+	grid_nj_ = (nj_ + cell_ - 1) / cell_;
+	grid_.assign(grid_ni_ * grid_nj_, vcl_vector<int>());
+
+	for (n=0; n < size(); n++)
+		grid_[(centers_[2*n] / cell_) + (centers_[2*n + 1] / cell_) * grid_ni_].push_back(n);
+}
+
+int compact_patch_db::insert_filled(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled,
+			int i, int j,
+			const vnl_matrix<int>& was_unfilled
+			)
+{
+	int a, b, ci, cj;
+	int added = 0;
+	int sz = 2*w_ + 1;
+
+// the pasted pixels lie within w of (i,j), so only patches centered within 2w of (i,j) can have become full
+	int i0 = vcl_max(w_, i - 2*w_), i1 = vcl_min(ni_ - w_ - 1, i + 2*w_);
+	int j0 = vcl_max(w_, j - 2*w_), j1 = vcl_min(nj_ - w_ - 1, j + 2*w_);
+	if ((i0 > i1) || (j0 > j1))
+		return 0;
+
+// summed-area table of the unfilled mask over the union of the candidate windows
+	mask_sat sat;
+	sat.build(unfilled, i0 - w_, j0 - w_, i1 - i0 + 2*w_ + 1, j1 - j0 + 2*w_ + 1);
+
+// running sums of the pixels the fill has just changed, over the patch centered at (i,j)
+	vcl_vector<int> filled((sz+1) * (sz+1), 0);
+	for (a=0; a < sz; a++)
+		for (b=0; b < sz; b++)
+			filled[(a+1)*(sz+1) + b+1] = filled[a*(sz+1) + b+1] + filled[(a+1)*(sz+1) + b] - filled[a*(sz+1) + b] +
+										 (was_unfilled(a, b) ? 1 : 0);
+
+	for (ci=i0; ci <= i1; ci++)
+		for (cj=j0; cj <= j1; cj++) {
+// a patch that does not overlap a filled pixel was already full, and so already stored, or is still not full
+			int a0 = vcl_max(ci, i) - w_ - (i - w_), a1 = vcl_min(ci, i) + w_ - (i - w_) + 1;
+			int b0 = vcl_max(cj, j) - w_ - (j - w_), b1 = vcl_min(cj, j) + w_ - (j - w_) + 1;
+			if (filled[a1*(sz+1) + b1] - filled[a0*(sz+1) + b1] - filled[a1*(sz+1) + b0] + filled[a0*(sz+1) + b0] == 0)
+				continue;
+
+			if (sat.patch_full(ci, cj, w_)) {
+				append_patch(im, ci, cj);
+				added++;
+			}
+		}
+
+	return added;
+}
+
+void compact_patch_db::try_patch(const packed_patch& target, int n, long& min, int& match) const
+{
+	long sum = masked_ssd(patches() + (vcl_size_t) n * patch_bytes_, stride_, true, target, min);
+
+	if ((min < 0) || (sum < min)) {
+		min = sum;
+		match = n;
+	}
+}
+
+bool compact_patch_db::lookup(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int& source_i,
+			int& source_j
+			) const
+{
+	int i, n, match = 0;
+	long min = -1;
+	packed_patch target;
+
+// if the data structures were not correctly initialized, quit the lookup operation
+	if (size() == 0)
+		return false;
+
+// if the size of the supplied matrices is NOT equal to the patch size, quit the lookup operation
+	for (i=0; i < nplanes; i++)
+		if (((int) target_planes[i].rows() != 2*w_+1) || ((int) target_planes[i].columns() != 2*w_+1))
+			return false;
+
+	target.pack(target_planes, nplanes, target_unfilled, layout_);
+
+// stream through the packed patches; each one is padded to whole vectors, so the kernel never needs a scalar tail
+	for (n=0; n < size(); n++)
+		try_patch(target, n, min, match);
+
+	source_i = centers_[2*match];
+	source_j = centers_[2*match + 1];
+
+	return true;
+}
+
+bool compact_patch_db::lookup_near(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int target_i,
+			int target_j,
+			int radius,
+			double threshold,
+			int& source_i,
+			int& source_j
+			) const
+{
+	int a, b, k, n, pi, pj;
+	int match = -1;
+	long min = -1;
+	packed_patch target;
+
+	if ((size() == 0) || (cell_ == 0))
+		return lookup(target_planes, nplanes, target_unfilled, source_i, source_j);
+
+	for (k=0; k < nplanes; k++)
+		if (((int) target_planes[k].rows() != 2*w_+1) || ((int) target_planes[k].columns() != 2*w_+1))
+			return false;
+
+	target.pack(target_planes, nplanes, target_unfilled, layout_);
+
+// visit only the cells overlapping the search window
+	int a0 = vcl_max(0, target_i - radius) / cell_, a1 = vcl_min(ni_ - 1, target_i + radius) / cell_;
+	int b0 = vcl_max(0, target_j - radius) / cell_, b1 = vcl_min(nj_ - 1, target_j + radius) / cell_;
+
+	for (b=b0; b <= b1; b++)
+		for (a=a0; a <= a1; a++) {
+			const vcl_vector<int>& cell = grid_[a + b*grid_ni_];
+			for (k=0; k < (int) cell.size(); k++) {
+				n = cell[k];
+				if ((vcl_abs(centers_[2*n] - target_i) > radius) || (vcl_abs(centers_[2*n + 1] - target_j) > radius))
+					continue;
+				try_patch(target, n, min, match);
+			}
+		}
+
+// the local match is accepted only if it is good enough
+	int known = 0;
+	for (pi=0; pi <= 2*w_; pi++)
+		for (pj=0; pj <= 2*w_; pj++)
+			if (!target_unfilled(pi, pj))
+				known += nplanes;
+
+	if ((match < 0) || ((known > 0) && (min > threshold * known)))
+		return lookup(target_planes, nplanes, target_unfilled, source_i, source_j);
+
+	source_i = centers_[2*match];
+	source_j = centers_[2*match + 1];
+
+	return true;
+}
+
+vcl_size_t compact_patch_db::footprint() const
+{
+	return sizeof(*this) +
+		   buffer_.capacity() * sizeof(vxl_byte) +
+		   centers_.capacity() * sizeof(int) +
+		   grid_.capacity() * sizeof(vcl_vector<int>) +
+		   (cell_ > 0 ? (vcl_size_t) size() * sizeof(int) : 0);
+}
@@ -0,0 +1,112 @@
+#ifndef COMPACT_PATCH_DB_H
+#define COMPACT_PATCH_DB_H
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+#include <vnl/vnl_matrix.h>
+#include <vcl_vector.h>
+#include <vcl_cstddef.h>
+#include "patch_ssd.h"
+
+// A patch database with a compact, cache-friendly memory layout
+//
+// patch_db keeps a deep copy of the whole source image plus a (ni*nj)x2 matrix of patch centers, and a lookup
+// jumps around the image to gather every candidate. Here only the full source patches are stored: each one is
+// packed contiguously (interleaved or planar 8-bit rows, see patch_layout) and padded to a multiple of 32 bytes in
+// a single 32-byte aligned buffer, so a lookup streams linearly through memory and compares patches with
+// masked_ssd() without a scalar tail. For w=4 a patch takes 256 bytes in either layout.
+// The centers of the stored patches are kept in the same order, two ints per valid patch.
+class compact_patch_db {
+public:
+	compact_patch_db(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			vil_image_view<bool> unfilled, int patch_radius,
+			patch_layout layout = PATCH_INTERLEAVED
+			);
+
+// same interface and result as patch_db::lookup()
+	bool lookup(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int& source_i,
+			int& source_j
+			) const;
+
+// spatially bounded lookup: only the patches centered within radius (in both i and j) of the target center
+// (target_i, target_j) are compared, using the grid index built by build_grid(). If none of them has a mean
+// squared error per known sample of at most threshold, or the grid has not been built, the lookup falls back
+// to the global search of lookup().
+	bool lookup_near(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int target_i,
+			int target_j,
+			int radius,
+			double threshold,
+			int& source_i,
+			int& source_j
+			) const;
+
+// buckets the patch centers into square cells of the given size; cell ~ radius keeps a bounded lookup to at
+// most 3x3 cells. Patches inserted later are added to the grid too.
+	void build_grid(int cell);
+
+// incremental maintenance as the hole shrinks: after the unfilled pixels of the patch centered at (i,j) have been
+// filled, inserts the source patches that just became full. im and unfilled must already reflect the fill;
+// was_unfilled is the (2w+1)x(2w+1) unfilled mask of the patch before the fill, as passed to lookup(). A full
+// patch is new exactly when it overlaps one of those pixels, so no per-pixel record of the stored patches is kept.
+// Only centers within 2w of (i,j) can be affected, so the cost is proportional to the patch area.
+// Returns the number of patches added to the database.
+	int insert_filled(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled,
+			int i, int j,
+			const vnl_matrix<int>& was_unfilled
+			);
+
+// number of patches in the database
+	int size() const { return (int) centers_.size() / 2; }
+
+// memory used by the database, in bytes
+	vcl_size_t footprint() const;
+
+	patch_layout layout() const { return layout_; }
+
+private:
+	void compute_patch_centers(vil_image_view<bool> uf);
+
+// makes room for n patches, keeping the stored ones
+	void reserve_patches(int n);
+
+// copies the patch of im centered at (i,j) to the end of the buffer
+	void append_patch(const vil_image_view<vil_rgb<vxl_byte> >& im, int i, int j);
+
+// evaluates patch n and updates the best match if its distance is smaller than min
+	void try_patch(const packed_patch& target, int n, long& min, int& match) const;
+
+// start of the first patch (the buffer is over-allocated so that it can be aligned to 32 bytes)
+	vxl_byte* patches();
+	const vxl_byte* patches() const;
+
+	int w_;
+	int nplanes_;
+	int ni_, nj_;
+	patch_layout layout_;
+
+// size in bytes of one padded packed patch and length of one of its rows
+	int patch_bytes_;
+	int stride_;
+
+	vcl_vector<vxl_byte> buffer_;
+	int capacity_;
+	vcl_vector<int> centers_;
+
+// grid index of the patch centers: cell (a,b) covers centers with i/cell_ == a and j/cell_ == b
+	int cell_;
+	int grid_ni_, grid_nj_;
+	vcl_vector< vcl_vector<int> > grid_;
+};
+
+#endif
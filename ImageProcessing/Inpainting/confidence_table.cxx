@@ -0,0 +1,90 @@
+#include "confidence_table.h"
+#include <vcl_algorithm.h>
+
+confidence_table::confidence_table()
+{
+	ni_ = nj_ = 0;
+}
+
+void confidence_table::build(const vil_image_view<double>& C, const vil_image_view<bool>& unfilled)
+{
+	int i, j, p;
+
+	ni_ = C.ni();
+	nj_ = C.nj();
+	value_.assign(ni_ * nj_, 0.0);
+	tree_.assign((ni_ + 1) * (nj_ + 1), 0.0);
+
+	for (j=0; j < nj_; j++)
+		for (i=0; i < ni_; i++)
+			if (!unfilled(i, j)) {
+				value_[i + j*ni_] = C(i, j);
+				tree_[(i+1) + (j+1)*(ni_+1)] = C(i, j);
+			}
+
+// linear-time construction: push every node into its parent, first along i and then along j
+	for (j=1; j <= nj_; j++)
+		for (i=1; i <= ni_; i++) {
+			p = i + (i & -i);
+			if (p <= ni_)
+				tree_[p + j*(ni_+1)] += tree_[i + j*(ni_+1)];
+		}
+	for (j=1; j <= nj_; j++) {
+		p = j + (j & -j);
+		if (p <= nj_)
+			for (i=1; i <= ni_; i++)
+				tree_[i + p*(ni_+1)] += tree_[i + j*(ni_+1)];
+	}
+}
+
+void confidence_table::set(int i, int j, double value)
+{
+	int a, b;
+	double delta = value - value_[i + j*ni_];
+
+	if (delta == 0)
+		return;
+	value_[i + j*ni_] = value;
+
+	for (b=j+1; b <= nj_; b += b & -b)
+		for (a=i+1; a <= ni_; a += a & -a)
+			tree_[a + b*(ni_+1)] += delta;
+}
+
+void confidence_table::update(
+			const vil_image_view<double>& C,
+			const vil_image_view<bool>& unfilled,
+			int i, int j, int w
+			)
+{
+	int a, b;
+	int i0 = vcl_max(0, i - w), i1 = vcl_min(ni_ - 1, i + w);
+	int j0 = vcl_max(0, j - w), j1 = vcl_min(nj_ - 1, j + w);
+
+	for (b=j0; b <= j1; b++)
+		for (a=i0; a <= i1; a++)
+			set(a, b, unfilled(a, b) ? 0.0 : C(a, b));
+}
+
+double confidence_table::prefix(int i, int j) const
+{
+	int a, b;
+	double s = 0.0;
+
+	for (b=j+1; b > 0; b -= b & -b)
+		for (a=i+1; a > 0; a -= a & -a)
+			s += tree_[a + b*(ni_+1)];
+	return s;
+}
+
+double confidence_table::sum(int i0, int j0, int i1, int j1) const
+{
+	i0 = vcl_max(0, i0);
+	j0 = vcl_max(0, j0);
+	i1 = vcl_min(ni_ - 1, i1);
+	j1 = vcl_min(nj_ - 1, j1);
+	if ((i0 > i1) || (j0 > j1))
+		return 0.0;
+
+	return prefix(i1, j1) - prefix(i0 - 1, j1) - prefix(i1, j0 - 1) + prefix(i0 - 1, j0 - 1);
+}
@@ -0,0 +1,50 @@
+#ifndef CONFIDENCE_TABLE_H
+#define CONFIDENCE_TABLE_H
+
+#include <vil/vil_image_view.h>
+#include <vcl_vector.h>
+
+// Summed confidence of the filled pixels, kept in a 2D Fenwick tree
+//
+// compute_C() sums C(i,j) over the filled pixels of the patch, which costs O(w^2) per front pixel per iteration.
+// The table stores v(i,j) = C(i,j) for filled pixels and 0 for unfilled ones in a 2D Fenwick (binary indexed)
+// tree, so any rectangle sum takes O(log ni * log nj). Pasting a patch changes v only inside the patch, and
+// update() applies those changes as point updates in O(w^2 log ni log nj).
+class confidence_table {
+public:
+	confidence_table();
+
+	void build(const vil_image_view<double>& C, const vil_image_view<bool>& unfilled);
+
+// re-reads C and unfilled inside the patch of radius w centered at (i,j)
+	void update(const vil_image_view<double>& C, const vil_image_view<bool>& unfilled, int i, int j, int w);
+
+// sets v(i,j)
+	void set(int i, int j, double value);
+
+// sum of v over [i0, i1] x [j0, j1], clipped to the image
+	double sum(int i0, int j0, int i1, int j1) const;
+
+// the confidence term of compute_C(): sum over the patch of radius w centered at (i,j) divided by (2w+1)^2
+	double confidence(int i, int j, int w) const
+	{
+		return sum(i - w, j - w, i + w, j + w) / ((2*w + 1) * (2*w + 1));
+	}
+
+private:
+// sum of v over [0, i] x [0, j]
+	double prefix(int i, int j) const;
+
+	int ni_, nj_;
+
+// current values of v, and the (ni_+1)x(nj_+1) tree (1-based, contiguous along i)
+	vcl_vector<double> value_;
+	vcl_vector<double> tree_;
+};
+
+class psi;
+
+// compute_C() on a confidence table
+double compute_C(psi& PSI, const confidence_table& table);
+
+#endif
@@ -0,0 +1,116 @@
+#include "fill_front_queue.h"
+
+fill_front_queue::fill_front_queue()
+{
+	ni_ = 0;
+}
+
+fill_front_queue::fill_front_queue(int ni, int nj)
+{
+	set_size(ni, nj);
+}
+
+void fill_front_queue::set_size(int ni, int nj)
+{
+	ni_ = ni;
+	heap_.clear();
+	key_.clear();
+	pos_.set_size(ni, nj);
+	pos_.fill(-1);
+}
+
+void fill_front_queue::swap_nodes(int n, int m)
+{
+	vcl_swap(heap_[n], heap_[m]);
+	vcl_swap(key_[n], key_[m]);
+	pos_(heap_[n] % ni_, heap_[n] / ni_) = n;
+	pos_(heap_[m] % ni_, heap_[m] / ni_) = m;
+}
+
+void fill_front_queue::sift_up(int n)
+{
+	while (n > 0) {
+		int parent = (n - 1) / 2;
+		if (!before(n, parent))
+			break;
+		swap_nodes(n, parent);
+		n = parent;
+	}
+}
+
+void fill_front_queue::sift_down(int n)
+{
+	int sz = size();
+
+	for (;;) {
+		int child = 2*n + 1;
+		if (child >= sz)
+			break;
+// pick the larger of the two children
+		if ((child + 1 < sz) && before(child + 1, child))
+			child++;
+		if (!before(child, n))
+			break;
+		swap_nodes(n, child);
+		n = child;
+	}
+}
+
+void fill_front_queue::update(int i, int j, double priority)
+{
+	int n = pos_(i, j);
+
+	if (n < 0) {
+		heap_.push_back(i + j*ni_);
+		key_.push_back(priority);
+		n = size() - 1;
+		pos_(i, j) = n;
+		sift_up(n);
+	} else {
+		key_[n] = priority;
+		sift_up(n);
+		sift_down(n);
+	}
+}
+
+void fill_front_queue::remove(int i, int j)
+{
+	int n = pos_(i, j);
+	int last = size() - 1;
+
+	if (n < 0)
+		return;
+
+// move the last node into the hole and restore the heap property from there
+	if (n != last) {
+		swap_nodes(n, last);
+		heap_.pop_back();
+		key_.pop_back();
+		sift_up(n);
+		sift_down(n);
+	} else {
+		heap_.pop_back();
+		key_.pop_back();
+	}
+	pos_(i, j) = -1;
+}
+
+bool fill_front_queue::top(int& i, int& j, double& priority) const
+{
+	if (empty())
+		return false;
+
+	i = heap_[0] % ni_;
+	j = heap_[0] / ni_;
+	priority = key_[0];
+	return true;
+}
+
+bool fill_front_queue::pop(int& i, int& j, double& priority)
+{
+	if (!top(i, j, priority))
+		return false;
+
+	remove(i, j);
+	return true;
+}
@@ -0,0 +1,88 @@
+#ifndef FILL_FRONT_QUEUE_H
+#define FILL_FRONT_QUEUE_H
+
+#include <vil/vil_image_view.h>
+#include <vcl_vector.h>
+#include <vcl_algorithm.h>
+
+// Indexed max-heap of fill-front priorities
+//
+// Instead of re-evaluating compute_C()*compute_D() for every fill-front pixel on every iteration, the priorities
+// are kept in a heap that also records the heap position of every pixel. Pasting a patch of radius w centered at
+// (i,j) can only change the priorities of front pixels whose patches overlap it, ie. pixels within 2w of (i,j),
+// so refresh() re-evaluates just that window: pixels that left the front are removed, new and remaining front
+// pixels get their new priority. Every heap operation is O(log n) in the length of the front.
+//
+// Equal priorities are popped in raster order (smaller j first, then smaller i), so the fill order does not depend
+// on the order of the updates nor on the shape of the heap.
+class fill_front_queue {
+public:
+	fill_front_queue();
+	fill_front_queue(int ni, int nj);
+
+	void set_size(int ni, int nj);
+
+	bool empty() const { return heap_.empty(); }
+	int size() const { return (int) heap_.size(); }
+
+	bool contains(int i, int j) const { return pos_(i, j) >= 0; }
+
+// inserts pixel (i,j) or changes its priority
+	void update(int i, int j, double priority);
+
+// removes pixel (i,j) if it is in the queue
+	void remove(int i, int j);
+
+// returns the pixel with the highest priority without removing it; false if the queue is empty
+	bool top(int& i, int& j, double& priority) const;
+
+// removes the pixel with the highest priority; false if the queue is empty
+	bool pop(int& i, int& j, double& priority);
+
+// fills the queue with all pixels of the fill front; priority(i,j) returns the priority of front pixel (i,j)
+	template <class priority_fn>
+	void build(const vil_image_view<bool>& fill_front, priority_fn& priority)
+	{
+		set_size(fill_front.ni(), fill_front.nj());
+		refresh(fill_front, 0, 0, vcl_max(fill_front.ni(), fill_front.nj()), priority);
+	}
+
+// re-evaluates the window [i-radius, i+radius] x [j-radius, j+radius] after a patch centered at (i,j) was pasted;
+// fill_front must already be the updated front. Use radius = 2w for patches of radius w.
+	template <class priority_fn>
+	void refresh(const vil_image_view<bool>& fill_front, int i, int j, int radius, priority_fn& priority)
+	{
+		int a, b;
+		int i0 = vcl_max(0, i - radius), i1 = vcl_min((int) fill_front.ni() - 1, i + radius);
+		int j0 = vcl_max(0, j - radius), j1 = vcl_min((int) fill_front.nj() - 1, j + radius);
+
+		for (b=j0; b <= j1; b++)
+			for (a=i0; a <= i1; a++)
+				if (fill_front(a, b))
+					update(a, b, priority(a, b));
+				else if (contains(a, b))
+					remove(a, b);
+	}
+
+private:
+// true if node n is popped before node m: higher priority, or equal priority and smaller pixel index
+	bool before(int n, int m) const
+	{
+		return (key_[n] > key_[m]) || ((key_[n] == key_[m]) && (heap_[n] < heap_[m]));
+	}
+
+	void swap_nodes(int n, int m);
+	void sift_up(int n);
+	void sift_down(int n);
+
+	int ni_;
+
+// heap of pixel indices i + j*ni_ and their priorities, stored in parallel
+	vcl_vector<int> heap_;
+	vcl_vector<double> key_;
+
+// pos_(i,j) is the heap position of pixel (i,j), or -1 if the pixel is not in the queue
+	vil_image_view<int> pos_;
+};
+
+#endif
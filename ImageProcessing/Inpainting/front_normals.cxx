@@ -0,0 +1,118 @@
+#include "front_normals.h"
+#include <vil/algo/vil_trace_8con_boundary.h>
+#include <vcl_cmath.h>
+
+front_normals::front_normals()
+{
+}
+
+void front_normals::reset(const vil_image_view<bool>& fill_front)
+{
+	contour_.set_size(fill_front.ni(), fill_front.nj());
+	index_.set_size(fill_front.ni(), fill_front.nj());
+	contour_.fill(-1);
+	contour_i_.clear();
+	contour_j_.clear();
+	stale_.clear();
+}
+
+void front_normals::invalidate(int i, int j, int w)
+{
+	int a, b, c;
+	int r = w + 2; // the front moves by at most one pixel beyond the pasted patch, and contours connect 8-neighbours
+
+	for (b=j-r; b <= j+r; b++)
+		for (a=i-r; a <= i+r; a++) {
+			if ((a < 0) || (b < 0) || (a >= (int) contour_.ni()) || (b >= (int) contour_.nj()))
+				continue;
+			c = contour_(a, b);
+			if (c >= 0)
+				stale_[c] = true;
+		}
+}
+
+const vcl_vector<double>& front_normals::filter(int w)
+{
+	int t;
+
+	if ((int) filters_.size() <= w)
+		filters_.resize(w + 1);
+
+	vcl_vector<double>& f = filters_[w];
+	if (f.empty()) {
+// With weights W(t) = exp(-t^2) and rows X(t) = [1, t, t^2/2], the normal matrix X^T W^2 X has no odd moments,
+// so it is [[S0, 0, S2/2], [0, S2, 0], [S2/2, 0, S4/4]] with Sn = sum W(t)^2 t^n and the row of its inverse
+// that yields the tangent is simply [0, 1/S2, 0]
+		double s2 = 0;
+		for (t= -w; t <= w; t++)
+			s2 += vcl_exp(-2.0*t*t) * t*t;
+
+		f.resize(2*w + 1);
+		for (t= -w; t <= w; t++)
+			f[w + t] = vcl_exp(-2.0*t*t) * t / s2;
+	}
+	return f;
+}
+
+int front_normals::trace(const vil_image_view<bool>& fill_front, int i, int j)
+{
+	int k;
+	int c = contour_i_.size();
+
+	contour_i_.push_back(vcl_vector<int>());
+	contour_j_.push_back(vcl_vector<int>());
+	stale_.push_back(false);
+
+	vcl_vector<int>& ci = contour_i_[c];
+	vcl_vector<int>& cj = contour_j_[c];
+	vil_trace_8con_boundary(ci, cj, fill_front, i, j);
+
+// a thin contour is traversed on both sides; every pixel keeps the position of its first visit
+	for (k=(int) ci.size() - 1; k >= 0; k--) {
+		contour_(ci[k], cj[k]) = c;
+		index_(ci[k], cj[k]) = k;
+	}
+	return c;
+}
+
+bool front_normals::normal(const vil_image_view<bool>& fill_front, int i, int j, int w, vnl_double_2& normal)
+{
+	int k, n, c = contour_(i, j);
+
+	if ((c < 0) || stale_[c]) {
+// release the stale contour; its remaining pixels still refer to it and will be re-traced on demand
+		if (c >= 0) {
+			contour_i_[c].clear();
+			contour_j_[c].clear();
+		}
+		c = trace(fill_front, i, j);
+	}
+
+	const vcl_vector<int>& ci = contour_i_[c];
+	const vcl_vector<int>& cj = contour_j_[c];
+	int bsize = ci.size();
+	int pos = index_(i, j);
+
+// single pixel on the fill boundary
+	if (bsize <= 2)
+		return false;
+// if we have a region smaller than the patch, then we have less information
+	if (w > bsize)
+		w = (bsize - 1) / 2;
+
+	const vcl_vector<double>& f = filter(w);
+	double dx = 0, dy = 0;
+	for (k= -w; k <= w; k++) {
+		n = ((pos + k) % bsize + bsize) % bsize;
+		dx += f[w + k] * cj[n];
+		dy += f[w + k] * ci[n];
+	}
+	double length = vcl_sqrt(dx*dx + dy*dy);
+	if (length == 0)
+		return false;
+
+// calculate the normal from the tangent
+	normal(0) =  dx / length;
+	normal(1) = -dy / length;
+	return true;
+}
@@ -0,0 +1,60 @@
+#ifndef FRONT_NORMALS_H
+#define FRONT_NORMALS_H
+
+#include <vil/vil_image_view.h>
+#include <vnl/vnl_double_2.h>
+#include <vcl_vector.h>
+
+// Fill-front normal estimation without SVD
+//
+// compute_normal() fits x(t) = d0 + d1*t + d2*t^2/2 to the 2w+1 boundary points around the front pixel with a
+// Gaussian-weighted least-squares fit, by building X and W and taking the SVD pseudo-inverse of W*X every time.
+// Since X and W depend only on w, the tangent d1 is a fixed linear filter of the boundary coordinates:
+//     d1 = sum_k f_w(k) x(k),   f_w = row 1 of (X^T W^2 X)^-1 X^T W^2
+// The filters are computed once per w with a closed-form 3x3 inverse.
+//
+// The ordering of the boundary is also kept between calls: every front contour is traced once with
+// vil_trace_8con_boundary() and each front pixel remembers its contour and its position on it. Pasting a patch
+// only changes the front near the patch, so invalidate() marks the contours passing there as stale and they are
+// re-traced the next time one of their pixels is queried.
+class front_normals {
+public:
+	front_normals();
+
+// forgets all contours; must be called whenever the fill front is recomputed from scratch
+	void reset(const vil_image_view<bool>& fill_front);
+
+// marks the contours that pass near the patch of radius w centered at (i,j) as stale
+	void invalidate(int i, int j, int w);
+
+// unit normal of the fill front at front pixel (i,j) using 2w+1 boundary points, with the same conventions as
+// compute_normal(); returns false if the contour through (i,j) is too short to define a normal
+	bool normal(const vil_image_view<bool>& fill_front, int i, int j, int w, vnl_double_2& normal);
+
+// weights of the tangent filter f_w(-w..w)
+	const vcl_vector<double>& filter(int w);
+
+private:
+// traces the contour through front pixel (i,j) and returns its id
+	int trace(const vil_image_view<bool>& fill_front, int i, int j);
+
+// contour id and position on the contour of every front pixel (-1 if not traced)
+	vil_image_view<int> contour_;
+	vil_image_view<int> index_;
+
+	vcl_vector< vcl_vector<int> > contour_i_;
+	vcl_vector< vcl_vector<int> > contour_j_;
+	vcl_vector<bool> stale_;
+
+	vcl_vector< vcl_vector<double> > filters_;
+};
+
+class psi;
+
+// compute_normal() using the precomputed filters and the maintained contours
+bool compute_normal(psi&                        PSI,
+                    const vil_image_view<bool>& fill_front,
+                    front_normals&              normals,
+                    vnl_double_2&               normal);
+
+#endif
@@ -0,0 +1,229 @@
+#include "gradient_field.h"
+#include "mask_sat.h"
+#include <vcl_algorithm.h>
+#include <vcl_cmath.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// first pass of the separable Sobel filter along i: smoothing [1 2 1] and central difference [-1 0 1]
+// of the n+2 samples in src, written to s and d
+static void sobel_pass_i(const short* src, short* s, short* d, int n)
+{
+	int k = 0;
+
+#if defined(__AVX2__)
+	for (; k + 16 <= n; k += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*) (src + k));
+		__m256i b = _mm256_loadu_si256((const __m256i*) (src + k + 1));
+		__m256i c = _mm256_loadu_si256((const __m256i*) (src + k + 2));
+		_mm256_storeu_si256((__m256i*) (s + k), _mm256_add_epi16(_mm256_add_epi16(a, c), _mm256_add_epi16(b, b)));
+		_mm256_storeu_si256((__m256i*) (d + k), _mm256_sub_epi16(c, a));
+	}
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+	for (; k + 8 <= n; k += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*) (src + k));
+		__m128i b = _mm_loadu_si128((const __m128i*) (src + k + 1));
+		__m128i c = _mm_loadu_si128((const __m128i*) (src + k + 2));
+		_mm_storeu_si128((__m128i*) (s + k), _mm_add_epi16(_mm_add_epi16(a, c), _mm_add_epi16(b, b)));
+		_mm_storeu_si128((__m128i*) (d + k), _mm_sub_epi16(c, a));
+	}
+#endif
+	for (; k < n; k++) {
+		s[k] = src[k] + 2*src[k+1] + src[k+2];
+		d[k] = src[k+2] - src[k];
+	}
+}
+
+// second pass along j: gi = d(j-1) + 2 d(j) + d(j+1), gj = s(j+1) - s(j-1)
+static void sobel_pass_j(
+			const short* s0, const short* d0,
+			const short* d1,
+			const short* s2, const short* d2,
+			short* gi, short* gj, int n
+			)
+{
+	int k = 0;
+
+#if defined(__AVX2__)
+	for (; k + 16 <= n; k += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*) (d0 + k));
+		__m256i b = _mm256_loadu_si256((const __m256i*) (d1 + k));
+		__m256i c = _mm256_loadu_si256((const __m256i*) (d2 + k));
+		_mm256_storeu_si256((__m256i*) (gi + k), _mm256_add_epi16(_mm256_add_epi16(a, c), _mm256_add_epi16(b, b)));
+		_mm256_storeu_si256((__m256i*) (gj + k),
+							_mm256_sub_epi16(_mm256_loadu_si256((const __m256i*) (s2 + k)),
+											 _mm256_loadu_si256((const __m256i*) (s0 + k))));
+	}
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+	for (; k + 8 <= n; k += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*) (d0 + k));
+		__m128i b = _mm_loadu_si128((const __m128i*) (d1 + k));
+		__m128i c = _mm_loadu_si128((const __m128i*) (d2 + k));
+		_mm_storeu_si128((__m128i*) (gi + k), _mm_add_epi16(_mm_add_epi16(a, c), _mm_add_epi16(b, b)));
+		_mm_storeu_si128((__m128i*) (gj + k),
+						 _mm_sub_epi16(_mm_loadu_si128((const __m128i*) (s2 + k)),
+									   _mm_loadu_si128((const __m128i*) (s0 + k))));
+	}
+#endif
+	for (; k < n; k++) {
+		gi[k] = d0[k] + 2*d1[k] + d2[k];
+		gj[k] = s2[k] - s0[k];
+	}
+}
+
+gradient_field::gradient_field()
+{
+	ni_ = nj_ = 0;
+}
+
+void gradient_field::compute(const vil_image_view<vxl_byte>& inpainted_grayscale, const vil_image_view<bool>& unfilled)
+{
+	ni_ = inpainted_grayscale.ni();
+	nj_ = inpainted_grayscale.nj();
+
+	gi_.assign(ni_ * nj_, 0);
+	gj_.assign(ni_ * nj_, 0);
+	mag2_.assign(ni_ * nj_, -1);
+
+	compute_region(inpainted_grayscale, unfilled, 0, 0, ni_ - 1, nj_ - 1);
+}
+
+void gradient_field::update(
+			const vil_image_view<vxl_byte>& inpainted_grayscale,
+			const vil_image_view<bool>& unfilled,
+			int i, int j, int w
+			)
+{
+// a gradient depends on the 3x3 neighbourhood of its pixel, so the pasted patch affects a border of one pixel around it
+	compute_region(inpainted_grayscale, unfilled,
+				   vcl_max(0, i - w - 1), vcl_max(0, j - w - 1),
+				   vcl_min(ni_ - 1, i + w + 1), vcl_min(nj_ - 1, j + w + 1));
+}
+
+void gradient_field::compute_region(
+			const vil_image_view<vxl_byte>& im,
+			const vil_image_view<bool>& unfilled,
+			int i0, int j0, int i1, int j1
+			)
+{
+	int i, j, k, l;
+
+// border pixels never have a gradient
+	for (j=j0; j <= j1; j++)
+		for (i=i0; i <= i1; i++)
+			if ((i == 0) || (j == 0) || (i == ni_-1) || (j == nj_-1))
+				mag2_[i + j*ni_] = -1;
+
+	i0 = vcl_max(i0, 1);
+	j0 = vcl_max(j0, 1);
+	i1 = vcl_min(i1, ni_ - 2);
+	j1 = vcl_min(j1, nj_ - 2);
+	if ((i0 > i1) || (j0 > j1))
+		return;
+
+	int n = i1 - i0 + 1;
+
+// a pixel has a gradient only if its 3x3 neighbourhood contains no unfilled pixel
+	mask_sat sat;
+	sat.build(unfilled, i0 - 1, j0 - 1, n + 2, j1 - j0 + 3);
+
+// smoothed and differentiated versions of three consecutive lines, rotated as we move along j
+	vcl_vector<short> src(n + 2);
+	vcl_vector<short> s[3], d[3];
+	vcl_vector<short> gi(n), gj(n);
+	for (l=0; l < 3; l++) {
+		s[l].resize(n);
+		d[l].resize(n);
+	}
+
+	for (l=0; l < 3; l++) {
+		for (k=0; k < n + 2; k++)
+			src[k] = im(i0 - 1 + k, j0 - 1 + l);
+		sobel_pass_i(&src[0], &s[l][0], &d[l][0], n);
+	}
+
+	for (j=j0; j <= j1; j++) {
+		int p = (j - j0) % 3, c = (j - j0 + 1) % 3, q = (j - j0 + 2) % 3;
+
+		sobel_pass_j(&s[p][0], &d[p][0], &d[c][0], &s[q][0], &d[q][0], &gi[0], &gj[0], n);
+
+		for (k=0; k < n; k++) {
+			i = i0 + k;
+			gi_[i + j*ni_] = gi[k];
+			gj_[i + j*ni_] = gj[k];
+			if (sat.count(i-1, j-1, i+1, j+1) == 0)
+				mag2_[i + j*ni_] = gi[k]*gi[k] + gj[k]*gj[k];
+			else
+				mag2_[i + j*ni_] = -1;
+		}
+
+// the line j-1 is no longer needed, replace it with line j+2
+		if (j + 2 <= j1 + 1) {
+			for (k=0; k < n + 2; k++)
+				src[k] = im(i0 - 1 + k, j + 2);
+			sobel_pass_i(&src[0], &s[p][0], &d[p][0], n);
+		}
+	}
+}
+
+// maximum of n ints
+static int max_line(const int* v, int n)
+{
+	int k = 0;
+	int m = -1;
+
+#if defined(__AVX2__)
+	if (n >= 8) {
+		__m256i acc = _mm256_set1_epi32(-1);
+		for (; k + 8 <= n; k += 8)
+			acc = _mm256_max_epi32(acc, _mm256_loadu_si256((const __m256i*) (v + k)));
+		int lanes[8];
+		_mm256_storeu_si256((__m256i*) lanes, acc);
+		for (int l=0; l < 8; l++)
+			m = vcl_max(m, lanes[l]);
+	}
+#endif
+	for (; k < n; k++)
+		m = vcl_max(m, v[k]);
+	return m;
+}
+
+bool gradient_field::max_gradient(int i, int j, int w, vnl_double_2& grad) const
+{
+	int a, b;
+	int i0 = vcl_max(0, i - w), i1 = vcl_min(ni_ - 1, i + w);
+	int j0 = vcl_max(0, j - w), j1 = vcl_min(nj_ - 1, j + w);
+	int m = -1;
+
+	if ((i0 > i1) || (j0 > j1))
+		return false;
+
+// masked max-reduction: pixels without a gradient hold -1
+	for (b=j0; b <= j1; b++)
+		m = vcl_max(m, max_line(&mag2_[i0 + b*ni_], i1 - i0 + 1));
+
+	if (m < 0)
+		return false;
+	if (m == 0) {
+		grad(0) = 0;
+		grad(1) = 0;
+		return true;
+	}
+
+// return the first maximum in the order in which compute_gradient() visits the patch
+	for (a=i0; a <= i1; a++)
+		for (b=j0; b <= j1; b++)
+			if (mag2_[a + b*ni_] == m) {
+				double magnitude = vcl_sqrt((double) m);
+				grad(0) = gi_[a + b*ni_] / magnitude;
+				grad(1) = gj_[a + b*ni_] / magnitude;
+				return true;
+			}
+	return true;
+}
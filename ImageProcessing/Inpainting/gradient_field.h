@@ -0,0 +1,56 @@
+#ifndef GRADIENT_FIELD_H
+#define GRADIENT_FIELD_H
+
+#include <vil/vil_image_view.h>
+#include <vnl/vnl_double_2.h>
+#include <vcl_vector.h>
+
+// Persistent Sobel gradient field of the grayscale inpainted image
+//
+// compute_gradient() rebuilds the Sobel masks and copies every 3x3 neighbourhood of the patch into a vnl_vector
+// on each call. Here the gradient of every pixel is computed once with a separable Sobel filter (vectorised with
+// AVX2/SSE2 where available) and stored together with its squared magnitude. A pixel has a gradient only if it is
+// not on the image border and its 3x3 neighbourhood is completely filled, exactly as in compute_gradient().
+//
+// After a patch of radius w is pasted at (i,j), update() recomputes the (2w+3)x(2w+3) window whose gradients can
+// have changed, and max_gradient() answers the per-patch query as a masked max-reduction over the stored magnitudes.
+class gradient_field {
+public:
+	gradient_field();
+
+	void compute(const vil_image_view<vxl_byte>& inpainted_grayscale, const vil_image_view<bool>& unfilled);
+
+// recomputes the gradients affected by pasting the patch of radius w centered at (i,j)
+	void update(
+			const vil_image_view<vxl_byte>& inpainted_grayscale,
+			const vil_image_view<bool>& unfilled,
+			int i, int j, int w
+			);
+
+// strongest gradient inside the patch of radius w centered at (i,j), normalised to unit length, with the same
+// conventions as compute_gradient(): grad(0) is the derivative along i, grad(1) along j.
+// Returns false if no pixel of the patch has a gradient.
+	bool max_gradient(int i, int j, int w, vnl_double_2& grad) const;
+
+private:
+// recomputes the gradients of the pixels in [i0, i1] x [j0, j1]
+	void compute_region(
+			const vil_image_view<vxl_byte>& im,
+			const vil_image_view<bool>& unfilled,
+			int i0, int j0, int i1, int j1
+			);
+
+	int ni_, nj_;
+
+// derivatives along i and j, and the squared magnitude (-1 for pixels without a gradient), contiguous along i
+	vcl_vector<short> gi_;
+	vcl_vector<short> gj_;
+	vcl_vector<int> mag2_;
+};
+
+class psi;
+
+// compute_gradient() on a precomputed gradient field
+bool compute_gradient(psi& PSI, const gradient_field& field, vnl_double_2& grad);
+
+#endif
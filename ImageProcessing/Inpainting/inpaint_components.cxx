@@ -0,0 +1,233 @@
+#include "inpaint_components.h"
+#include "compact_patch_db.h"
+#include <vil/vil_copy.h>
+#include <vcl_vector.h>
+#include <vcl_algorithm.h>
+#include <vcl_utility.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// bounding box [i0,i1]x[j0,j1] of a hole, or of a group of holes
+struct hole_box {
+	int i0, j0, i1, j1;
+};
+
+static bool overlap(const hole_box& a, const hole_box& b, int margin)
+{
+	return (a.i0 - margin <= b.i1 + margin) && (b.i0 - margin <= a.i1 + margin) &&
+		   (a.j0 - margin <= b.j1 + margin) && (b.j0 - margin <= a.j1 + margin);
+}
+
+static int find_root(vcl_vector<int>& parent, int n)
+{
+	while (parent[n] != n)
+		n = parent[n] = parent[parent[n]];
+	return n;
+}
+
+// labels the 8-connected components of the unfilled mask (-1 for filled pixels) and returns their bounding boxes
+static void label_holes(const vil_image_view<bool>& unfilled, vil_image_view<int>& label, vcl_vector<hole_box>& boxes)
+{
+	int i, j, a, b;
+	int ni = unfilled.ni(), nj = unfilled.nj();
+	vcl_vector<int> stack;
+
+	label.set_size(ni, nj);
+	label.fill(-1);
+	boxes.clear();
+
+	for (j=0; j < nj; j++)
+		for (i=0; i < ni; i++) {
+			if (!unfilled(i, j) || (label(i, j) >= 0))
+				continue;
+
+			int n = boxes.size();
+			hole_box box = { i, j, i, j };
+
+			label(i, j) = n;
+			stack.push_back(i);
+			stack.push_back(j);
+			while (!stack.empty()) {
+				int pj = stack.back(); stack.pop_back();
+				int pi = stack.back(); stack.pop_back();
+
+				box.i0 = vcl_min(box.i0, pi);
+				box.i1 = vcl_max(box.i1, pi);
+				box.j0 = vcl_min(box.j0, pj);
+				box.j1 = vcl_max(box.j1, pj);
+
+				for (b=vcl_max(0, pj-1); b <= vcl_min(nj-1, pj+1); b++)
+					for (a=vcl_max(0, pi-1); a <= vcl_min(ni-1, pi+1); a++)
+						if (unfilled(a, b) && (label(a, b) < 0)) {
+							label(a, b) = n;
+							stack.push_back(a);
+							stack.push_back(b);
+						}
+			}
+			boxes.push_back(box);
+		}
+}
+
+// merges the holes whose boxes, grown by margin, overlap; the boxes of the merged groups are tested again until no
+// two groups overlap. group[n] receives the group of hole n and groups the bounding box of every group.
+static void group_holes(
+			const vcl_vector<hole_box>& boxes, int margin,
+			vcl_vector<int>& group, vcl_vector<hole_box>& groups
+			)
+{
+	int n, m, k;
+	vcl_vector<int> parent(boxes.size());
+
+	for (n=0; n < (int) boxes.size(); n++)
+		parent[n] = n;
+	groups = boxes;
+
+	bool merged = true;
+	while (merged) {
+		merged = false;
+
+// sweep along i: only groups whose grown boxes start before the end of the current one can overlap it
+		vcl_vector<vcl_pair<int, int> > order;
+		for (n=0; n < (int) boxes.size(); n++)
+			if (find_root(parent, n) == n)
+				order.push_back(vcl_pair<int, int>(groups[n].i0, n));
+		vcl_sort(order.begin(), order.end());
+
+		for (k=0; k < (int) order.size(); k++) {
+			n = order[k].second;
+			if (find_root(parent, n) != n)
+				continue;
+			for (m=k+1; (m < (int) order.size()) && (order[m].first - margin <= groups[n].i1 + margin); m++) {
+				int o = order[m].second;
+				if ((find_root(parent, o) != o) || !overlap(groups[n], groups[o], margin))
+					continue;
+
+				parent[o] = n;
+				groups[n].i0 = vcl_min(groups[n].i0, groups[o].i0);
+				groups[n].i1 = vcl_max(groups[n].i1, groups[o].i1);
+				groups[n].j0 = vcl_min(groups[n].j0, groups[o].j0);
+				groups[n].j1 = vcl_max(groups[n].j1, groups[o].j1);
+				merged = true;
+			}
+		}
+	}
+
+// renumber the groups 0..k-1
+	vcl_vector<int> index(boxes.size(), -1);
+	vcl_vector<hole_box> roots;
+	group.resize(boxes.size());
+	for (n=0; n < (int) boxes.size(); n++) {
+		int r = find_root(parent, n);
+		if (index[r] < 0) {
+			index[r] = roots.size();
+			roots.push_back(groups[r]);
+		}
+		group[n] = index[r];
+	}
+	groups.swap(roots);
+}
+
+bool inpaint_components(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled,
+			const inpaint_params& params,
+			vil_image_view<vil_rgb<vxl_byte> >& result,
+			int threads,
+			inpaint_stats* stats
+			)
+{
+	int n;
+	int w = params.w;
+	int ni = im.ni(), nj = im.nj();
+	int margin = 2*w + 2;
+
+// a grown database would let the holes read each other's pasted patches
+	if (((params.engine != INPAINT_EXHAUSTIVE) && (params.engine != INPAINT_BOUNDED)) || params.grow_db)
+		return inpaint_exemplar(im, unfilled, params, result, 0, stats);
+
+	vil_image_view<int> label;
+	vcl_vector<hole_box> boxes, groups;
+	vcl_vector<int> group;
+	label_holes(unfilled, label, boxes);
+	group_holes(boxes, margin, group, groups);
+
+// a single group gains nothing from tiling
+	if (groups.size() <= 1)
+		return inpaint_exemplar(im, unfilled, params, result, 0, stats);
+
+// the shared database: patches that are full under the whole mask, centers in image coordinates
+	compact_patch_db db(im, unfilled, w);
+	if (params.engine == INPAINT_BOUNDED)
+		db.build_grid(params.search_radius);
+
+	vil_copy_deep(im, result);
+
+// the largest groups first, so that a big hole does not start last
+	vcl_vector<vcl_pair<long, int> > order;
+	for (n=0; n < (int) groups.size(); n++)
+		order.push_back(vcl_pair<long, int>(-(long) (groups[n].i1 - groups[n].i0 + 1) * (groups[n].j1 - groups[n].j0 + 1), n));
+	vcl_sort(order.begin(), order.end());
+
+	bool ok = true;
+	int ngroups = groups.size();
+
+#ifdef _OPENMP
+	if (threads <= 0)
+		threads = omp_get_max_threads();
+#endif
+
+#pragma omp parallel for schedule(dynamic) num_threads(threads) if (threads > 1)
+	for (n=0; n < ngroups; n++) {
+		int g = order[n].second;
+		int a, b;
+
+// the window of the group, clipped to the image
+		int i0 = vcl_max(0, groups[g].i0 - margin), i1 = vcl_min(ni - 1, groups[g].i1 + margin);
+		int j0 = vcl_max(0, groups[g].j0 - margin), j1 = vcl_min(nj - 1, groups[g].j1 + margin);
+		int tni = i1 - i0 + 1, tnj = j1 - j0 + 1;
+
+		vil_image_view<vil_rgb<vxl_byte> > tile(tni, tnj), filled;
+		vil_image_view<bool> tile_unfilled(tni, tnj);
+		for (b=0; b < tnj; b++)
+			for (a=0; a < tni; a++) {
+				tile(a, b) = im(i0+a, j0+b);
+				tile_unfilled(a, b) = unfilled(i0+a, j0+b);
+			}
+
+		inpaint_params p = params;
+		p.db = &db;
+		p.source = &im;
+		p.origin_i = i0;
+		p.origin_j = j0;
+		p.guide = 0;
+
+		inpaint_stats tile_stats;
+		bool tile_ok = inpaint_exemplar(tile, tile_unfilled, p, filled, 0, &tile_stats);
+
+// windows of different groups are disjoint, so the merge needs no synchronisation
+		if (filled)
+			for (b=0; b < tnj; b++)
+				for (a=0; a < tni; a++)
+					if (tile_unfilled(a, b))
+						result(i0+a, j0+b) = filled(a, b);
+
+#pragma omp critical(inpaint_components_merge)
+		{
+			if (!tile_ok)
+				ok = false;
+			if (stats) {
+				stats->setup += tile_stats.setup;
+				stats->build += tile_stats.build;
+				stats->priority += tile_stats.priority;
+				stats->lookup += tile_stats.lookup;
+				stats->paste += tile_stats.paste;
+				stats->update += tile_stats.update;
+				stats->lookups += tile_stats.lookups;
+				stats->guided += tile_stats.guided;
+			}
+		}
+	}
+
+	return ok;
+}
@@ -0,0 +1,29 @@
+#ifndef INPAINT_COMPONENTS_H
+#define INPAINT_COMPONENTS_H
+
+#include "inpaint_exemplar.h"
+
+// Tile-parallel exemplar-based inpainting of masks made of many disjoint holes (dust, scratches, ...)
+//
+// The 8-connected components of the unfilled mask are grouped so that the windows of different groups -- their
+// bounding boxes grown by a margin of 2w+2 pixels, which covers every patch, gradient and normal computation
+// around a hole -- do not overlap. Each group is then inpainted independently on its own window, on up to threads
+// OpenMP threads (0 for the default), by inpaint_exemplar() in tile mode: all of them search one read-only
+// compact_patch_db built from the patches of im that are full under the whole mask, and paste from im. The
+// windows are finally merged into result.
+//
+// Groups never read each other's pixels and the fill_front_queue breaks priority ties in raster order, which is the
+// same in a window and in the whole image, so the result is the one of inpaint_exemplar() on the whole image; only
+// the interleaving of the groups differs. Only INPAINT_EXHAUSTIVE and INPAINT_BOUNDED can share a database, and
+// only without grow_db; otherwise the whole image is inpainted at once. stats, if given, accumulates the
+// statistics of all groups (their times add up over the threads).
+bool inpaint_components(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled,
+			const inpaint_params& params,
+			vil_image_view<vil_rgb<vxl_byte> >& result,
+			int threads = 0,
+			inpaint_stats* stats = 0
+			);
+
+#endif
@@ -0,0 +1,329 @@
+#include "inpaint_exemplar.h"
+#include "compact_patch_db.h"
+#include "patch_match.h"
+#include "patch_index.h"
+#include "patch_ssd.h"
+#include "mask_sat.h"
+#include "fill_front_queue.h"
+#include "confidence_table.h"
+#include "gradient_field.h"
+#include "front_normals.h"
+#include <vil/vil_copy.h>
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_double_2.h>
+#include <vcl_algorithm.h>
+#include <vcl_cmath.h>
+#include <chrono>
+
+// the state of an inpainting run that the priority of a front pixel depends on
+struct inpaint_state {
+	int w;
+	double alpha;
+
+	vil_image_view<vil_rgb<vxl_byte> > im;
+	vil_image_view<vxl_byte> gray;
+	vil_image_view<bool> unfilled;
+	vil_image_view<bool> front;
+	vil_image_view<double> C;
+
+	confidence_table confidence;
+	gradient_field gradients;
+	front_normals normals;
+
+// priority C(p)*D(p) of front pixel (i,j), with D(p) computed as in compute_D()
+	double operator()(int i, int j)
+	{
+		vnl_double_2 grad, normal;
+		double D;
+
+		if (gradients.max_gradient(i, j, w, grad)) {
+			if (normals.normal(front, i, j, w, normal))
+				D = vcl_fabs(-grad(1)*normal(0) + grad(0)*normal(1)) / alpha;
+			else if (alpha > 0)
+				D = 1 / alpha;
+			else
+				D = 0;
+		} else
+			D = 0;
+
+		return confidence.confidence(i, j, w) * D;
+	}
+};
+
+// accumulates the wall time elapsed between consecutive calls of lap() into a field of an inpaint_stats, if any
+class phase_clock {
+public:
+	phase_clock(inpaint_stats* stats) : stats_(stats), last_(stats ? seconds() : 0) {}
+
+	void lap(double inpaint_stats::* phase)
+	{
+		if (!stats_)
+			return;
+		double t = seconds();
+		stats_->*phase += t - last_;
+		last_ = t;
+	}
+
+private:
+	static double seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	inpaint_stats* stats_;
+	double last_;
+};
+
+static vxl_byte to_gray(const vil_rgb<vxl_byte>& v)
+{
+	return (vxl_byte) ((77*v.r + 150*v.g + 29*v.b) >> 8);
+}
+
+// an unfilled pixel is on the fill front if one of its 8 neighbours is filled
+static bool on_front(const vil_image_view<bool>& uf, int i, int j)
+{
+	int a, b;
+
+	if (!uf(i, j))
+		return false;
+	for (b=vcl_max(0, j-1); b <= vcl_min((int) uf.nj()-1, j+1); b++)
+		for (a=vcl_max(0, i-1); a <= vcl_min((int) uf.ni()-1, i+1); a++)
+			if (!uf(a, b))
+				return true;
+	return false;
+}
+
+// best full source patch centered within radius of (gi,gj); false if the window holds no full patch
+static bool guided_lookup(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const mask_sat& source,
+			const packed_patch& target,
+			int w, int gi, int gj, int radius,
+			int& source_i, int& source_j
+			)
+{
+	int i, j;
+	long sum, min = -1;
+	vcl_ptrdiff_t row_step = im.jstep() * sizeof(vil_rgb<vxl_byte>);
+
+	for (j=vcl_max(w, gj - radius); j <= vcl_min((int) im.nj() - w - 1, gj + radius); j++)
+		for (i=vcl_max(w, gi - radius); i <= vcl_min((int) im.ni() - w - 1, gi + radius); i++) {
+			if (!source.patch_full(i, j, w))
+				continue;
+			sum = masked_ssd((const vxl_byte*) &im(i-w, j-w), row_step, false, target, min);
+			if ((min < 0) || (sum < min)) {
+				min = sum;
+				source_i = i;
+				source_j = j;
+			}
+		}
+	return min >= 0;
+}
+
+// the global lookup engine of a run
+struct lookup_engine {
+	lookup_engine() : own_db(0), db(0), pm(0), index(0) {}
+	~lookup_engine()
+	{
+		delete own_db;
+		delete pm;
+		delete index;
+	}
+
+	bool built() const { return db || pm || index; }
+
+	void build(const vil_image_view<vil_rgb<vxl_byte> >& im, const vil_image_view<bool>& unfilled,
+			   const inpaint_params& params)
+	{
+		if (params.engine == INPAINT_PATCHMATCH)
+			pm = new patch_match(im, unfilled, params.w, params.quality);
+		else if (params.engine == INPAINT_KDTREE)
+			index = new patch_index(im, unfilled, params.w, params.index_dims, params.index_candidates);
+		else if (params.db)
+			db = params.db;
+		else {
+			db = own_db = new compact_patch_db(im, unfilled, params.w);
+			if (params.engine == INPAINT_BOUNDED)
+				own_db->build_grid(params.search_radius);
+		}
+	}
+
+	compact_patch_db* own_db;
+	const compact_patch_db* db;
+	patch_match* pm;
+	patch_index* index;
+};
+
+bool inpaint_exemplar(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled,
+			const inpaint_params& params,
+			vil_image_view<vil_rgb<vxl_byte> >& result,
+			vil_image_view<int>* offsets,
+			inpaint_stats* stats
+			)
+{
+	int i, j, a, b, pi, pj;
+	int w = params.w;
+	int ni = im.ni(), nj = im.nj();
+	double priority;
+
+	if ((ni < 2*w+1) || (nj < 2*w+1))
+		return false;
+// tile mode pastes from *source, which only the compact_patch_db engines search, and never from a guide window
+	if (params.source && (!params.db || params.guide ||
+						  ((params.engine != INPAINT_EXHAUSTIVE) && (params.engine != INPAINT_BOUNDED))))
+		return false;
+
+	phase_clock clock(stats);
+	inpaint_state s;
+	s.w = w;
+	s.alpha = params.alpha;
+	vil_copy_deep(im, s.im);
+	vil_copy_deep(unfilled, s.unfilled);
+
+	if (offsets) {
+		offsets->set_size(ni, nj, 2);
+		offsets->fill(0);
+	}
+
+// confidence is 1 for filled pixels and 0 for unfilled ones
+	s.C.set_size(ni, nj);
+	s.gray.set_size(ni, nj);
+	s.front.set_size(ni, nj);
+	for (j=0; j < nj; j++)
+		for (i=0; i < ni; i++) {
+			s.C(i, j) = s.unfilled(i, j) ? 0.0 : 1.0;
+			s.gray(i, j) = to_gray(s.im(i, j));
+		}
+	for (j=0; j < nj; j++)
+		for (i=0; i < ni; i++)
+			s.front(i, j) = on_front(s.unfilled, i, j);
+
+	s.confidence.build(s.C, s.unfilled);
+	s.gradients.compute(s.gray, s.unfilled);
+	s.normals.reset(s.front);
+	clock.lap(&inpaint_stats::setup);
+
+// the lookup engine. A guided run only needs it when a guide window holds no full patch, so it is built on the
+// first such miss; a database that grows has to see every fill, so it is built at once.
+	lookup_engine engine;
+	bool grows = params.grow_db && !params.db &&
+				 (params.engine != INPAINT_PATCHMATCH) && (params.engine != INPAINT_KDTREE);
+	if (!params.guide || grows)
+		engine.build(im, unfilled, params);
+
+// full patches of the original source region, for the guided search
+	mask_sat source;
+	if (params.guide)
+		source.build(unfilled);
+	clock.lap(&inpaint_stats::build);
+
+	fill_front_queue queue;
+	queue.build(s.front, s);
+
+	vnl_matrix<int> target_planes[3];
+	vnl_matrix<int> target_unfilled(2*w+1, 2*w+1);
+	for (a=0; a < 3; a++)
+		target_planes[a].set_size(2*w+1, 2*w+1);
+	packed_patch target;
+
+	bool ok = true;
+	while (queue.pop(i, j, priority)) {
+		clock.lap(&inpaint_stats::priority);
+
+// keep the whole patch inside the image; the shifted patch still covers the front pixel
+		int ci = vcl_max(w, vcl_min(ni - w - 1, i));
+		int cj = vcl_max(w, vcl_min(nj - w - 1, j));
+
+		for (pi= -w; pi <= w; pi++)
+			for (pj= -w; pj <= w; pj++) {
+				const vil_rgb<vxl_byte>& v = s.im(ci+pi, cj+pj);
+				target_planes[0](w+pi, w+pj) = v.r;
+				target_planes[1](w+pi, w+pj) = v.g;
+				target_planes[2](w+pi, w+pj) = v.b;
+				target_unfilled(w+pi, w+pj) = s.unfilled(ci+pi, cj+pj) ? 1 : 0;
+			}
+
+		int si = -1, sj = -1;
+		bool found = false;
+		if (params.guide) {
+			target.pack(target_planes, 3, target_unfilled);
+			found = guided_lookup(s.im, source, target, w,
+								  ci + (*params.guide)(ci, cj, 0), cj + (*params.guide)(ci, cj, 1),
+								  params.guide_radius, si, sj);
+			if (found && stats)
+				stats->guided++;
+		}
+		if (!found) {
+			if (!engine.built()) {
+				clock.lap(&inpaint_stats::lookup);
+				engine.build(im, unfilled, params);
+				clock.lap(&inpaint_stats::build);
+			}
+			if (engine.pm)
+				found = engine.pm->lookup(target_planes, 3, target_unfilled, ci, cj, si, sj);
+			else if (engine.index)
+				found = engine.index->lookup(target_planes, 3, target_unfilled, si, sj);
+			else if (params.engine == INPAINT_BOUNDED)
+				found = engine.db->lookup_near(target_planes, 3, target_unfilled,
+										ci + params.origin_i, cj + params.origin_j,
+										params.search_radius, params.search_threshold, si, sj);
+			else
+				found = engine.db->lookup(target_planes, 3, target_unfilled, si, sj);
+		}
+		if (stats)
+			stats->lookups++;
+		clock.lap(&inpaint_stats::lookup);
+		if (!found) {
+			ok = false;
+			break;
+		}
+
+// paste the unfilled pixels; they inherit the confidence of the target patch
+		const vil_image_view<vil_rgb<vxl_byte> >& from = params.source ? *params.source : s.im;
+		double conf = s.confidence.confidence(ci, cj, w);
+		for (pi= -w; pi <= w; pi++)
+			for (pj= -w; pj <= w; pj++) {
+				if (!s.unfilled(ci+pi, cj+pj))
+					continue;
+				s.im(ci+pi, cj+pj) = from(si+pi, sj+pj);
+				s.gray(ci+pi, cj+pj) = to_gray(s.im(ci+pi, cj+pj));
+				s.unfilled(ci+pi, cj+pj) = false;
+				s.C(ci+pi, cj+pj) = conf;
+				if (offsets) {
+					(*offsets)(ci+pi, cj+pj, 0) = si - ci - params.origin_i;
+					(*offsets)(ci+pi, cj+pj, 1) = sj - cj - params.origin_j;
+				}
+			}
+
+		clock.lap(&inpaint_stats::paste);
+
+// bring every incremental structure up to date around the pasted patch
+		s.confidence.update(s.C, s.unfilled, ci, cj, w);
+		s.gradients.update(s.gray, s.unfilled, ci, cj, w);
+		for (b=vcl_max(0, cj-w-1); b <= vcl_min(nj-1, cj+w+1); b++)
+			for (a=vcl_max(0, ci-w-1); a <= vcl_min(ni-1, ci+w+1); a++)
+				s.front(a, b) = on_front(s.unfilled, a, b);
+		s.normals.invalidate(ci, cj, w);
+		if (engine.own_db && params.grow_db)
+			engine.own_db->insert_filled(s.im, s.unfilled, ci, cj, target_unfilled);
+
+		clock.lap(&inpaint_stats::update);
+
+// only front pixels whose patches overlap the pasted one can change priority
+		queue.refresh(s.front, ci, cj, 2*w + 2, s);
+	}
+	clock.lap(&inpaint_stats::priority);
+
+// pixels that are not connected to the filled region never reach the fill front
+	for (j=0; ok && (j < nj); j++)
+		for (i=0; i < ni; i++)
+			if (s.unfilled(i, j)) {
+				ok = false;
+				break;
+			}
+
+	result = s.im;
+	return ok;
+}
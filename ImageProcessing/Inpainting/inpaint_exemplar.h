@@ -0,0 +1,90 @@
+#ifndef INPAINT_EXEMPLAR_H
+#define INPAINT_EXEMPLAR_H
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+
+class compact_patch_db;
+
+// Patch lookup engines available to the headless inpainting routines
+enum inpaint_engine {
+	INPAINT_EXHAUSTIVE,		// exact search over a compact_patch_db
+	INPAINT_PATCHMATCH,		// approximate search with patch_match
+	INPAINT_BOUNDED,		// search of a compact_patch_db restricted to a window around the target
+	INPAINT_KDTREE			// k-d tree over PCA descriptors of the patches (patch_index), re-ranked exactly
+};
+
+// Parameters of an exemplar-based inpainting run
+struct inpaint_params {
+	inpaint_params()
+		: w(4), alpha(255.0), engine(INPAINT_EXHAUSTIVE), quality(4), grow_db(false),
+		  search_radius(32), search_threshold(100.0), index_dims(16), index_candidates(16), db(0),
+		  source(0), origin_i(0), origin_j(0), guide(0), guide_radius(0) {}
+
+	int w;					// patch radius
+	double alpha;			// normalisation factor of the data term
+	inpaint_engine engine;
+	int quality;			// quality/speed knob of INPAINT_PATCHMATCH
+	bool grow_db;			// insert patches that become full while the hole shrinks (compact_patch_db engines)
+	int search_radius;		// half size of the INPAINT_BOUNDED search window
+	double search_threshold;	// squared error per known sample above which INPAINT_BOUNDED searches globally
+	int index_dims;			// descriptor dimension of INPAINT_KDTREE
+	int index_candidates;	// number of INPAINT_KDTREE candidates re-ranked with the exact masked SSD
+
+// optional database shared between runs on the same source image (INPAINT_EXHAUSTIVE and INPAINT_BOUNDED). It
+// is only read, so it may be used by several threads at once; it must hold patches of im that are full under
+// unfilled, and grow_db is ignored. For INPAINT_BOUNDED its grid must already be built.
+	const compact_patch_db* db;
+
+// optional tile mode, which requires db, INPAINT_EXHAUSTIVE or INPAINT_BOUNDED and no guide: im is the window of
+// *source whose top-left pixel is (origin_i, origin_j), db holds patches of *source (centers in source coordinates)
+// and the pasted pixels are read from *source. The offsets returned by inpaint_exemplar() are relative to the
+// source image too.
+	const vil_image_view<vil_rgb<vxl_byte> >* source;
+	int origin_i, origin_j;
+
+// optional initial guess of the nearest-neighbour field (plane 0: offset along i, plane 1: along j). When given,
+// the source patch of a target centered at p is searched among the full patches centered within guide_radius of
+// p + guide(p), and the global engine is used only if that window holds no full patch. The engine is then built on
+// the first such miss (at once if grow_db applies), and that time is counted in inpaint_stats::build.
+	const vil_image_view<int>* guide;
+	int guide_radius;
+};
+
+// Wall time (in seconds) spent in each phase of inpaint_exemplar() and lookup counters. The routines that take
+// an inpaint_stats add to its fields, so one object can accumulate several runs.
+struct inpaint_stats {
+	inpaint_stats()
+		: setup(0), build(0), priority(0), lookup(0), paste(0), update(0), lookups(0), guided(0) {}
+
+	double setup;			// confidences, gray levels, gradients, fill front and normals of the input
+	double build;			// construction of the lookup engine
+	double priority;		// priority queue construction, pops and refreshes
+	double lookup;			// gathering of the target patches and patch lookups
+	double paste;			// copy of the source pixels
+	double update;			// incremental update of confidences, gradients, front, normals and database
+	int lookups;			// number of lookups
+	int guided;				// lookups answered within the guide window
+};
+
+// Headless exemplar-based inpainting (Criminisi et al.)
+//
+// Fills the unfilled pixels of im in order of decreasing priority C(p)*D(p), pasting for every fill-front pixel
+// the best matching source patch. The priorities live in a fill_front_queue and only the ones near a pasted patch
+// are re-evaluated, using the incrementally maintained confidence_table, gradient_field and front_normals.
+//
+// If offsets is given it receives the nearest-neighbour field of the result: for every pasted pixel the offset
+// to the pixel it was copied from, 0 elsewhere.
+// If stats is given the time spent in each phase and the number of lookups are added to it.
+// Returns false if the image holds no full source patch or if some unfilled pixel cannot be reached from the
+// filled region.
+bool inpaint_exemplar(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled,
+			const inpaint_params& params,
+			vil_image_view<vil_rgb<vxl_byte> >& result,
+			vil_image_view<int>* offsets = 0,
+			inpaint_stats* stats = 0
+			);
+
+#endif
@@ -0,0 +1,63 @@
+#include "inpaint_io.h"
+#include <vil/vil_load.h>
+#include <vil/vil_image_resource.h>
+#include <vil/vil_save.h>
+
+bool load_rgb(const vcl_string& fname, vil_image_view<vil_rgb<vxl_byte> >& im)
+{
+	int i, j;
+	vil_image_view<vxl_byte> in = vil_load(fname.c_str());
+
+	if (!in || ((in.nplanes() != 1) && (in.nplanes() < 3)))
+		return false;
+
+	im.set_size(in.ni(), in.nj());
+	for (j=0; j < (int) in.nj(); j++)
+		for (i=0; i < (int) in.ni(); i++)
+			if (in.nplanes() == 1)
+				im(i, j) = vil_rgb<vxl_byte>(in(i, j), in(i, j), in(i, j));
+			else
+				im(i, j) = vil_rgb<vxl_byte>(in(i, j, 0), in(i, j, 1), in(i, j, 2));
+	return true;
+}
+
+bool image_size(const vcl_string& fname, int& ni, int& nj)
+{
+	vil_image_resource_sptr in = vil_load_image_resource(fname.c_str());
+
+	if (!in)
+		return false;
+
+	ni = in->ni();
+	nj = in->nj();
+	return true;
+}
+
+bool load_mask(const vcl_string& fname, int ni, int nj, vil_image_view<bool>& unfilled)
+{
+	int i, j;
+	vil_image_view<vxl_byte> in = vil_load(fname.c_str());
+
+	if (!in || ((int) in.ni() != ni) || ((int) in.nj() != nj))
+		return false;
+
+	unfilled.set_size(ni, nj);
+	for (j=0; j < nj; j++)
+		for (i=0; i < ni; i++)
+			unfilled(i, j) = (in(i, j, 0) != 0);
+	return true;
+}
+
+bool save_rgb(const vcl_string& fname, const vil_image_view<vil_rgb<vxl_byte> >& im)
+{
+	int i, j;
+	vil_image_view<vxl_byte> out(im.ni(), im.nj(), 3);
+
+	for (j=0; j < (int) im.nj(); j++)
+		for (i=0; i < (int) im.ni(); i++) {
+			out(i, j, 0) = im(i, j).r;
+			out(i, j, 1) = im(i, j).g;
+			out(i, j, 2) = im(i, j).b;
+		}
+	return vil_save(out, fname.c_str());
+}
@@ -0,0 +1,22 @@
+#ifndef INPAINT_IO_H
+#define INPAINT_IO_H
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+#include <vcl_string.h>
+
+// Image input/output of the headless inpainting tools
+
+// loads a color or gray-level image; gray levels are replicated to the three channels
+bool load_rgb(const vcl_string& fname, vil_image_view<vil_rgb<vxl_byte> >& im);
+
+// reads the size of an image from its header, without decoding the pixels
+bool image_size(const vcl_string& fname, int& ni, int& nj);
+
+// loads a mask of size ni x nj; a pixel is unfilled if its first plane is non-zero
+bool load_mask(const vcl_string& fname, int ni, int nj, vil_image_view<bool>& unfilled);
+
+// saves a color image as three planes of bytes
+bool save_rgb(const vcl_string& fname, const vil_image_view<vil_rgb<vxl_byte> >& im);
+
+#endif
@@ -0,0 +1,100 @@
+#include "inpaint_multiscale.h"
+#include <vcl_vector.h>
+#include <vcl_algorithm.h>
+
+// Halves an image and its mask. A coarse pixel is the average of the filled pixels of its 2x2 block and is
+// unfilled if any of them is, so the coarse hole always covers the fine one.
+//
+// (The Laplacian pyramid class of the Blending module expects (2^N+1)x(2^N+1) single-plane images and smooths
+// across the hole boundary, so it is not used here.)
+static void halve(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& uf,
+			vil_image_view<vil_rgb<vxl_byte> >& im2,
+			vil_image_view<bool>& uf2
+			)
+{
+	int i, j, a, b;
+	int ni = im.ni(), nj = im.nj();
+	int ni2 = (ni + 1) / 2, nj2 = (nj + 1) / 2;
+
+	im2.set_size(ni2, nj2);
+	uf2.set_size(ni2, nj2);
+
+	for (j=0; j < nj2; j++)
+		for (i=0; i < ni2; i++) {
+			int r = 0, g = 0, bl = 0, n = 0;
+			bool hole = false;
+
+			for (b=2*j; b < vcl_min(nj, 2*j+2); b++)
+				for (a=2*i; a < vcl_min(ni, 2*i+2); a++)
+					if (uf(a, b))
+						hole = true;
+					else {
+						r += im(a, b).r;
+						g += im(a, b).g;
+						bl += im(a, b).b;
+						n++;
+					}
+
+			uf2(i, j) = hole;
+			if (n > 0)
+				im2(i, j) = vil_rgb<vxl_byte>(r / n, g / n, bl / n);
+			else
+				im2(i, j) = vil_rgb<vxl_byte>(0, 0, 0);
+		}
+}
+
+bool inpaint_multiscale(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled,
+			const inpaint_params& params,
+			int levels,
+			int radius,
+			vil_image_view<vil_rgb<vxl_byte> >& result,
+			inpaint_stats* stats
+			)
+{
+	int l, i, j;
+
+// every level builds its own database from its own image, and the levels below the top make their own guides
+	if (params.db || params.source || params.origin_i || params.origin_j || params.guide)
+		return false;
+
+// build the image and mask pyramids; stop when a level would be too small for a useful search
+	vcl_vector< vil_image_view<vil_rgb<vxl_byte> > > ims(1, im);
+	vcl_vector< vil_image_view<bool> > ufs(1, unfilled);
+	for (l=1; l < levels; l++) {
+		if ((int) vcl_min(ims[l-1].ni(), ims[l-1].nj()) / 2 < 4*params.w + 2)
+			break;
+		ims.push_back(vil_image_view<vil_rgb<vxl_byte> >());
+		ufs.push_back(vil_image_view<bool>());
+		halve(ims[l-1], ufs[l-1], ims[l], ufs[l]);
+	}
+	int top = ims.size() - 1;
+
+// coarsest level: global search
+	vil_image_view<int> nnf, guide;
+	if (!inpaint_exemplar(ims[top], ufs[top], params, result, &nnf, stats))
+		return false;
+
+// finer levels: restricted search around the upsampled nearest-neighbour field
+	inpaint_params local = params;
+	local.guide = &guide;
+	local.guide_radius = radius;
+
+	for (l=top-1; l >= 0; l--) {
+		int ni = ims[l].ni(), nj = ims[l].nj();
+
+		guide.set_size(ni, nj, 2);
+		for (j=0; j < nj; j++)
+			for (i=0; i < ni; i++) {
+				guide(i, j, 0) = 2 * nnf(i/2, j/2, 0);
+				guide(i, j, 1) = 2 * nnf(i/2, j/2, 1);
+			}
+
+		if (!inpaint_exemplar(ims[l], ufs[l], local, result, &nnf, stats))
+			return false;
+	}
+	return true;
+}
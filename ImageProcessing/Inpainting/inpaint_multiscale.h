@@ -0,0 +1,26 @@
+#ifndef INPAINT_MULTISCALE_H
+#define INPAINT_MULTISCALE_H
+
+#include "inpaint_exemplar.h"
+
+// Coarse-to-fine exemplar-based inpainting
+//
+// The image and its mask are halved up to levels-1 times (or until the patch no longer fits). The coarsest level
+// is inpainted with the global engine of params, where the database is tiny. At every finer level the
+// nearest-neighbour field of the level below is upsampled (offsets doubled) and used as the guide of
+// inpaint_exemplar(), so the source patch of each target is searched only within radius pixels of its predicted
+// position. Global search is used at fine levels only when that window holds no full patch.
+// If stats is given it accumulates the statistics of all levels.
+// The shared database, tile mode and guide of params (db, source, origin_i/origin_j, guide) are in full-resolution
+// coordinates and cannot be used at the coarse levels: the routine returns false if any of them is set.
+bool inpaint_multiscale(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled,
+			const inpaint_params& params,
+			int levels,
+			int radius,
+			vil_image_view<vil_rgb<vxl_byte> >& result,
+			inpaint_stats* stats = 0
+			);
+
+#endif
@@ -0,0 +1,261 @@
+// Inpainting benchmark and quality/performance regression harness
+//
+// usage: inpainting_bench [options] [corpus]
+//	-w radius	patch radius (default: 4)
+//	-q quality	quality knob of the patchmatch engine (default: 4)
+//	-r radius	search radius of the bounded engine (default: 32)
+//	-l levels	number of levels of the multiscale run (default: 3)
+//	-b db		quality budget: an engine fails if its PSNR on some image is more than db below the one of the
+//				exhaustive engine (default: 3)
+//	-o file		write the per-run results to file instead of stdout
+//
+// Every non-empty corpus line that does not start with '#' holds "image mask". The image is the ground truth: the
+// pixels under the mask are inpainted from the rest of the image and compared with the original ones. Without a
+// corpus a fixed synthetic one is generated, so that runs on different machines and builds stay comparable.
+//
+// Every image is inpainted with each lookup engine. For each run the wall time of every phase of
+// inpaint_exemplar() (see inpaint_stats), the number of lookups and the PSNR over the hole are reported, followed
+// by a per-engine summary with the speed-up over the exhaustive engine and the worst PSNR loss. The exit status
+// is non-zero if a run fails or an engine exceeds the quality budget.
+
+#include "inpaint_exemplar.h"
+#include "inpaint_multiscale.h"
+#include "inpaint_io.h"
+#include <vnl/vnl_random.h>
+#include <vcl_iostream.h>
+#include <vcl_fstream.h>
+#include <vcl_sstream.h>
+#include <vcl_iomanip.h>
+#include <vcl_string.h>
+#include <vcl_vector.h>
+#include <vcl_cmath.h>
+#include <vcl_cstdlib.h>
+#include <vcl_cstring.h>
+#include <vcl_algorithm.h>
+#include <chrono>
+
+// PSNR reported when the hole is reconstructed exactly
+static const double max_psnr = 99.0;
+
+struct bench_image {
+	vcl_string name;
+	vil_image_view<vil_rgb<vxl_byte> > im;
+	vil_image_view<bool> unfilled;
+};
+
+struct bench_engine {
+	const char* name;
+	inpaint_engine engine;
+	bool multiscale;
+
+// accumulated over the corpus
+	double time;
+	double worst_loss;
+	double psnr;
+	int failures;
+};
+
+// the synthetic corpus: a smooth texture with noise, diagonal stripes and a checkerboard, with round and
+// rectangular holes
+static void synthetic_corpus(vcl_vector<bench_image>& corpus)
+{
+	int i, j, n;
+	int ni = 192, nj = 160;
+	vnl_random rand(9667566);
+
+	corpus.resize(3);
+	corpus[0].name = "synthetic_texture";
+	corpus[1].name = "synthetic_stripes";
+	corpus[2].name = "synthetic_checker";
+
+	for (n=0; n < 3; n++) {
+		corpus[n].im.set_size(ni, nj);
+		corpus[n].unfilled.set_size(ni, nj);
+		for (j=0; j < nj; j++)
+			for (i=0; i < ni; i++) {
+				int v;
+				if (n == 0)
+					v = (int) (120 + 50*vcl_sin(0.31*i + 0.7*vcl_sin(0.13*j)) + 40*vcl_cos(0.23*j + 0.05*i)) +
+						rand.lrand32(0, 15);
+				else if (n == 1)
+					v = ((i + j) % 12 < 5) ? 40 : 210;
+				else
+					v = ((i/10 + j/10) % 2) ? 30 : 220;
+
+				corpus[n].im(i, j) = vil_rgb<vxl_byte>(v, (v + 64) % 256, 255 - v);
+
+				int di = i - ni/2, dj = j - nj/2;
+				if (n == 1)
+					corpus[n].unfilled(i, j) = (vcl_abs(di) < 25) && (vcl_abs(dj) < 15);
+				else
+					corpus[n].unfilled(i, j) = (di*di + dj*dj < 22*22);
+			}
+	}
+}
+
+static bool read_corpus(const char* fname, vcl_vector<bench_image>& corpus)
+{
+	vcl_ifstream in(fname);
+	vcl_string line;
+
+	if (!in)
+		return false;
+
+	while (vcl_getline(in, line)) {
+		vcl_istringstream fields(line);
+		vcl_string image, mask;
+		bench_image b;
+
+		if (!(fields >> image) || (image[0] == '#'))
+			continue;
+		if (!(fields >> mask) || !load_rgb(image, b.im) || !load_mask(mask, b.im.ni(), b.im.nj(), b.unfilled)) {
+			vcl_cerr << "inpainting_bench: cannot load " << line << "\n";
+			return false;
+		}
+		b.name = image;
+		corpus.push_back(b);
+	}
+	return true;
+}
+
+// PSNR of result against truth over the unfilled pixels
+static double hole_psnr(
+			const vil_image_view<vil_rgb<vxl_byte> >& truth,
+			const vil_image_view<vil_rgb<vxl_byte> >& result,
+			const vil_image_view<bool>& unfilled
+			)
+{
+	int i, j;
+	double sum = 0;
+	long n = 0;
+
+	for (j=0; j < (int) truth.nj(); j++)
+		for (i=0; i < (int) truth.ni(); i++) {
+			if (!unfilled(i, j))
+				continue;
+			double dr = truth(i, j).r - result(i, j).r;
+			double dg = truth(i, j).g - result(i, j).g;
+			double db = truth(i, j).b - result(i, j).b;
+			sum += dr*dr + dg*dg + db*db;
+			n += 3;
+		}
+
+	if ((n == 0) || (sum == 0))
+		return max_psnr;
+	return vcl_min(max_psnr, 10 * vcl_log10(255.0 * 255.0 * n / sum));
+}
+
+static int usage()
+{
+	vcl_cerr << "usage: inpainting_bench [-w radius] [-q quality] [-r radius] [-l levels] [-b db] [-o file] [corpus]\n";
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	inpaint_params params;
+	int levels = 3;
+	double budget = 3;
+	const char* out_fname = 0;
+	const char* corpus_fname = 0;
+	int a, n, e;
+
+	for (a=1; a < argc; a++) {
+		if (argv[a][0] != '-') {
+			if (corpus_fname)
+				return usage();
+			corpus_fname = argv[a];
+			continue;
+		}
+		if (a == argc - 1)
+			return usage();
+		if (!vcl_strcmp(argv[a], "-w"))
+			params.w = vcl_atoi(argv[++a]);
+		else if (!vcl_strcmp(argv[a], "-q"))
+			params.quality = vcl_atoi(argv[++a]);
+		else if (!vcl_strcmp(argv[a], "-r"))
+			params.search_radius = vcl_atoi(argv[++a]);
+		else if (!vcl_strcmp(argv[a], "-l"))
+			levels = vcl_atoi(argv[++a]);
+		else if (!vcl_strcmp(argv[a], "-b"))
+			budget = vcl_atof(argv[++a]);
+		else if (!vcl_strcmp(argv[a], "-o"))
+			out_fname = argv[++a];
+		else
+			return usage();
+	}
+
+	vcl_vector<bench_image> corpus;
+	if (!corpus_fname)
+		synthetic_corpus(corpus);
+	else if (!read_corpus(corpus_fname, corpus))
+		return 1;
+
+// the exhaustive engine comes first: it is the quality reference of the others
+	bench_engine engines[] = {
+		{ "exhaustive", INPAINT_EXHAUSTIVE, false, 0, 0, 0, 0 },
+		{ "patchmatch", INPAINT_PATCHMATCH, false, 0, 0, 0, 0 },
+		{ "bounded", INPAINT_BOUNDED, false, 0, 0, 0, 0 },
+		{ "kdtree", INPAINT_KDTREE, false, 0, 0, 0, 0 },
+		{ "multiscale", INPAINT_EXHAUSTIVE, true, 0, 0, 0, 0 }
+	};
+	int nengines = sizeof(engines) / sizeof(engines[0]);
+
+	vcl_ofstream file;
+	if (out_fname)
+		file.open(out_fname);
+	vcl_ostream& out = out_fname ? (vcl_ostream&) file : vcl_cout;
+
+	out << vcl_fixed << vcl_setprecision(3);
+	out << "# image engine status total setup build priority lookup paste update lookups guided psnr\n";
+
+	for (n=0; n < (int) corpus.size(); n++) {
+		double reference = 0;
+
+		for (e=0; e < nengines; e++) {
+			bench_engine& engine = engines[e];
+			inpaint_params p = params;
+			inpaint_stats stats;
+			vil_image_view<vil_rgb<vxl_byte> > result;
+
+			p.engine = engine.engine;
+			std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+			bool ok = engine.multiscale ?
+				inpaint_multiscale(corpus[n].im, corpus[n].unfilled, p, levels, 2*p.w, result, &stats) :
+				inpaint_exemplar(corpus[n].im, corpus[n].unfilled, p, result, 0, &stats);
+			double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+			double psnr = ok ? hole_psnr(corpus[n].im, result, corpus[n].unfilled) : 0;
+			if (e == 0)
+				reference = psnr;
+
+			engine.time += total;
+			engine.psnr += psnr;
+			engine.worst_loss = vcl_max(engine.worst_loss, reference - psnr);
+			if (!ok)
+				engine.failures++;
+
+			out << corpus[n].name << " " << engine.name << " " << (ok ? "ok" : "failed") << " "
+				<< total << " " << stats.setup << " " << stats.build << " " << stats.priority << " "
+				<< stats.lookup << " " << stats.paste << " " << stats.update << " "
+				<< stats.lookups << " " << stats.guided << " " << psnr << "\n";
+		}
+	}
+
+// summary: the speed-up and the PSNR loss are relative to the exhaustive engine
+	int status = 0;
+	out << "# engine time speedup mean_psnr worst_loss verdict\n";
+	for (e=0; e < nengines; e++) {
+		const bench_engine& engine = engines[e];
+		bool pass = (engine.failures == 0) && (engine.worst_loss <= budget);
+
+		out << "# " << engine.name << " " << engine.time << " "
+			<< (engine.time > 0 ? engines[0].time / engine.time : 0) << " "
+			<< (corpus.empty() ? 0 : engine.psnr / corpus.size()) << " "
+			<< engine.worst_loss << " " << (pass ? "pass" : "FAIL") << "\n";
+		if (!pass)
+			status = 1;
+	}
+
+	return status;
+}
@@ -2,6 +2,9 @@
 // See inpainting_eval.h for a detailed explanation of the input and output parameters of the routines you must implement
 
 #include "inpainting_eval.h"
+#include "gradient_field.h"
+#include "front_normals.h"
+#include "confidence_table.h"
 #include "math.h"
 
 // When beginning to write your code, I suggest you work in three steps:
@@ -74,6 +77,15 @@ double compute_C(      psi&                    PSI,
     return sum / pow(PSI.sz(), 2); // since size = 2*w + 1
 }
 
+// same as above, with the sum of the confidences of the filled pixels read from a summed table
+double compute_C(      psi&              PSI,
+                 const confidence_table& table)
+{
+    int w = PSI.w(), ceni = (int) PSI.p()(0), cenj = (int) PSI.p()(1);
+
+    return table.sum(ceni-w, cenj-w, ceni+w, cenj+w) / pow(PSI.sz(), 2);
+}
+
 bool compute_normal(psi&                 PSI,
 					vil_image_view<bool> fill_front, 
                     vnl_double_2&        normal)
@@ -136,6 +148,16 @@ bool compute_normal(psi&                 PSI,
     return true;
 }
 
+// same as above, but the tangent is obtained with a precomputed weighted least-squares filter and the boundary
+// ordering is reused between calls instead of being traced from scratch
+bool compute_normal(psi&                        PSI,
+                    const vil_image_view<bool>& fill_front,
+                    front_normals&              normals,
+                    vnl_double_2&               normal)
+{
+    return normals.normal(fill_front, (int) PSI.p()(0), (int) PSI.p()(1), PSI.w(), normal);
+}
+
 // return the gradient with the strongest magnitude inside the patch of radius w or return false if no gradients can be computed
 bool compute_gradient(      psi&                        PSI,
                       const vil_image_view<vxl_byte>&   inpainted_grayscale,
@@ -208,3 +230,12 @@ bool compute_gradient(      psi&                        PSI,
     }
     return computable;
 }
+
+// same as above, but the gradients come from a gradient field that is kept up to date with the inpainted image,
+// so the query is a max-reduction over the patch instead of a Sobel evaluation per pixel
+bool compute_gradient(      psi&            PSI,
+                      const gradient_field& field,
+                            vnl_double_2&   grad)
+{
+    return field.max_gradient((int) PSI.p()(0), (int) PSI.p()(1), PSI.w(), grad);
+}
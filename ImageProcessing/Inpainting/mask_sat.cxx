@@ -0,0 +1,82 @@
+#include "mask_sat.h"
+#include <vcl_algorithm.h>
+
+mask_sat::mask_sat()
+{
+	oi_ = oj_ = 0;
+	ni_ = nj_ = 0;
+}
+
+void mask_sat::build(const vil_image_view<bool>& mask)
+{
+	build(mask, 0, 0, mask.ni(), mask.nj());
+}
+
+void mask_sat::build(const vil_image_view<bool>& mask, int i0, int j0, int ni, int nj)
+{
+	int i, j;
+
+	oi_ = i0;
+	oj_ = j0;
+	ni_ = ni;
+	nj_ = nj;
+	sat_.assign((ni_+1) * (nj_+1), 0);
+
+// pass 1: running sums along i, every line j is independent
+#pragma omp parallel for private(i) if (ni_ * nj_ > 65536)
+	for (j=0; j < nj_; j++) {
+		int* row = &sat_[(j+1)*(ni_+1)];
+		for (i=0; i < ni_; i++)
+			row[i+1] = row[i] + (mask(oi_+i, oj_+j) ? 1 : 0);
+	}
+
+// pass 2: accumulate the lines along j; blocks of 256 columns are independent and are
+// swept line by line so that memory is still accessed contiguously
+	int b, nb = (ni_ + 255) / 256;
+#pragma omp parallel for private(i, j) if (ni_ * nj_ > 65536)
+	for (b=0; b < nb; b++) {
+		int i1 = vcl_min(ni_, 256*(b+1));
+		for (j=1; j <= nj_; j++)
+			for (i=1 + 256*b; i <= i1; i++)
+				sat_[j*(ni_+1) + i] += sat_[(j-1)*(ni_+1) + i];
+	}
+}
+
+void full_patch_centers(const vil_image_view<bool>& mask, int w, vcl_vector<int>& centers)
+{
+	int i, j;
+	int ni = mask.ni(), nj = mask.nj();
+	int rows = ni - 2*w;
+
+	if ((rows <= 0) || (nj - 2*w <= 0))
+		return;
+
+	mask_sat sat;
+	sat.build(mask);
+
+// first count the full patches of every row i so that each row knows where its centers go,
+// then let every row write its own centers; the result is identical to a sequential scan
+	vcl_vector<int> offset(rows + 1, 0);
+
+#pragma omp parallel for private(j) if (ni * nj > 65536)
+	for (i=0; i < rows; i++)
+		for (j=w; j < nj - w; j++)
+			if (sat.patch_full(w+i, j, w))
+				offset[i+1]++;
+
+	for (i=0; i < rows; i++)
+		offset[i+1] += offset[i];
+
+	int base = centers.size();
+	centers.resize(base + 2*offset[rows]);
+
+#pragma omp parallel for private(j) if (ni * nj > 65536)
+	for (i=0; i < rows; i++) {
+		int k = base + 2*offset[i];
+		for (j=w; j < nj - w; j++)
+			if (sat.patch_full(w+i, j, w)) {
+				centers[k++] = w+i;
+				centers[k++] = j;
+			}
+	}
+}
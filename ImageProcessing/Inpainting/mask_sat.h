@@ -0,0 +1,45 @@
+#ifndef MASK_SAT_H
+#define MASK_SAT_H
+
+#include <vil/vil_image_view.h>
+#include <vcl_vector.h>
+
+// Summed-area table (integral image) of a boolean mask
+//
+// After build(), count() returns the number of true pixels in any rectangle with four lookups, so testing whether
+// a patch of radius w contains an unfilled pixel costs O(1) instead of O((2w+1)^2).
+// The table may cover the whole mask or only a window of it; coordinates are always image coordinates.
+class mask_sat {
+public:
+	mask_sat();
+
+// table over the whole mask
+	void build(const vil_image_view<bool>& mask);
+
+// table over the window [i0, i0+ni) x [j0, j0+nj) of the mask
+	void build(const vil_image_view<bool>& mask, int i0, int j0, int ni, int nj);
+
+// number of true pixels in [i0, i1] x [j0, j1]; the rectangle must lie inside the table window
+	int count(int i0, int j0, int i1, int j1) const
+	{
+		i0 -= oi_; i1 += 1 - oi_;
+		j0 -= oj_; j1 += 1 - oj_;
+		return sat_[j1*(ni_+1) + i1] - sat_[j0*(ni_+1) + i1] - sat_[j1*(ni_+1) + i0] + sat_[j0*(ni_+1) + i0];
+	}
+
+// true if the patch of radius w centered at (i,j) contains no true pixel
+	bool patch_full(int i, int j, int w) const { return count(i-w, j-w, i+w, j+w) == 0; }
+
+private:
+	int oi_, oj_;
+	int ni_, nj_;
+
+// (ni_+1)x(nj_+1) table, contiguous along i like a vil_image_view
+	vcl_vector<int> sat_;
+};
+
+// Appends to centers the (i,j) pairs of all patches of radius w that contain no true pixel of mask, in the order
+// of the scan i = w..ni-w-1 (outer), j = w..nj-w-1 (inner). The scan is parallelised over i.
+void full_patch_centers(const vil_image_view<bool>& mask, int w, vcl_vector<int>& centers);
+
+#endif
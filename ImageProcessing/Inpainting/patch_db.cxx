@@ -2,6 +2,8 @@
 //  DO NOT MODIFY THIS FILE ANYWHERE EXCEPT WHERE EXPLICITLY NOTED!!!!
 
 #include "psi.h"
+#include "patch_ssd.h"
+#include "mask_sat.h"
 #include <math.h>
 #include <stdio.h>
 
@@ -25,33 +27,24 @@ patch_db::patch_db(
 	compute_patch_centers(im, unfilled);
 }
 
+// im is no longer needed: fullness depends only on the unfilled mask. It stays in the signature declared in psi.h
 void patch_db::compute_patch_centers(
-			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<vil_rgb<vxl_byte> >& /* im */,
 			vil_image_view<bool> uf
 			)
 {
-	int plane;
-	int i, j;
-	bool full;
-	int pi, pj;
-	int vi;
-
-// loop over all possible patch centers
-	top_ = 0;
-    for (i=w_; i < im.ni() - w_; i++)
-        for (j=w_; j < im.nj() - w_; j++) {
-			full = true;
-			patch_center_coords_(top_, 0) = i;
-			patch_center_coords_(top_, 1) = j;
-// loop over all pixels in a patch
-            for (pi= -w_, vi=0; (pi<=w_) && full; pi++)
-                for (pj= -w_; (pj<=w_) && full; pj++, vi++)
-// if pixel is unfilled, the patch is not completely full so this patch cannot be used for lookup operations
-                    if (uf(i+pi, j+pj) == true)
-						full = false;
-			if (full)
-				top_ += 1;
-		}
+	int n;
+	vcl_vector<int> centers;
+
+// a patch is full if the summed-area table of the unfilled mask counts no unfilled pixel in it;
+// this is O(1) per candidate center instead of a scan of the whole patch
+	full_patch_centers(uf, w_, centers);
+
+	top_ = centers.size() / 2;
+	for (n=0; n < top_; n++) {
+		patch_center_coords_(n, 0) = centers[2*n];
+		patch_center_coords_(n, 1) = centers[2*n + 1];
+	}
 }
 
 ///////////////////////////////////////////////////////////
@@ -67,7 +60,6 @@ bool patch_db::lookup(
 			)
 {
     int i, j, match;
-    double sum, min;
 
 // if the data structures were not correctly initialized, quit the lookup operation
 	if (top_ == 0)
@@ -80,34 +72,25 @@ bool patch_db::lookup(
 			return false;
 		
 /** ------------------------------- Added Code ----------------------------- **/
+// pack the known pixels of the target patch once, in the memory layout of a patch column of im_
+    packed_patch target;
+    target.pack(target_planes, nplanes, target_unfilled);
+
+// im_ is a deep copy, so its pixels are contiguous along i and a patch column is 3*(2w+1) consecutive bytes
+    vcl_ptrdiff_t row_step = im_.jstep() * sizeof(vil_rgb<vxl_byte>);
+
 // for each full patch in the source region
-    int n= 0;
-    while (n < top_) {
-        sum = 0.0;
-// loop over all pixels in a patch
-        for (int pi= -w_; pi <= w_; pi++) {
-            for (int pj= -w_; pj <= w_; pj++) {
-// compare pixel values if pixel in target patch is valid (filled)
-                if (!target_unfilled(w_+pi, w_+pj)) {
-                    i = patch_center_coords_(n, 0);
-                    j = patch_center_coords_(n, 1);
-
-                    sum += pow(target_planes[0](w_+pi, w_+pj) - im_(i+pi,j+pj).r, 2);
-                    sum += pow(target_planes[1](w_+pi, w_+pj) - im_(i+pi,j+pj).g, 2);
-                    sum += pow(target_planes[2](w_+pi, w_+pj) - im_(i+pi,j+pj).b, 2);
-// if min has been exceeded, then we can skip the rest of the pixels and go to the next patch
-                    if (sum > min && n > 0)
-                        goto nextPatch;
-                }
-            }
-        }
+    long sum, min = -1;
+    for (int n=0; n < top_; n++) {
+        i = patch_center_coords_(n, 0);
+        j = patch_center_coords_(n, 1);
 
+// the kernel stops as soon as a row leaves the partial sum above the best match so far
+        sum = masked_ssd((const vxl_byte*) &im_(i-w_, j-w_), row_step, false, target, min);
         if (min > sum || n == 0) {
             min = sum;
             match = n;
         }
-        nextPatch:
-        n++;
     }
 
 // get row and column coordinates of patch center
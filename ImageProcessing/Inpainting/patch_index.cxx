@@ -0,0 +1,344 @@
+#include "patch_index.h"
+#include "mask_sat.h"
+#include <vil/vil_copy.h>
+#include <vnl/vnl_vector.h>
+#include <vnl/algo/vnl_svd.h>
+#include <vnl/algo/vnl_symmetric_eigensystem.h>
+#include <vcl_algorithm.h>
+#include <vcl_functional.h>
+#include <vcl_utility.h>
+
+// the principal components are estimated from at most this many source patches
+static const int max_sample = 4096;
+
+// k-d tree leaves hold at most this many descriptors
+static const int leaf_size = 8;
+
+// orders source patches by one coordinate of their descriptors
+struct descriptor_less {
+	const float* desc;
+	int dims, dim;
+
+	bool operator()(int a, int b) const { return desc[a*dims + dim] < desc[b*dims + dim]; }
+};
+
+patch_index::patch_index(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled, int patch_radius,
+			int dims, int candidates
+			)
+{
+	w_ = patch_radius;
+	nplanes_ = 3;
+	d_ = nplanes_ * (2*w_+1) * (2*w_+1);
+	dims_ = vcl_max(1, vcl_min(dims, d_));
+	candidates_ = vcl_max(1, candidates);
+	min_known_ = 0.25;
+	max_leaves_ = 64;
+
+	vil_copy_deep(im, im_);
+	row_step_ = im_.jstep() * sizeof(vil_rgb<vxl_byte>);
+
+	full_patch_centers(unfilled, w_, centers_);
+	if (size() == 0)
+		return;
+
+	compute_basis();
+	compute_descriptors();
+
+	order_.resize(size());
+	for (int n=0; n < size(); n++)
+		order_[n] = n;
+	nodes_.clear();
+	build_tree(0, size());
+}
+
+void patch_index::gather(int i, int j, float* x) const
+{
+	int pi, pj;
+
+	for (pj= -w_; pj <= w_; pj++)
+		for (pi= -w_; pi <= w_; pi++) {
+			const vil_rgb<vxl_byte>& v = im_(i+pi, j+pj);
+			x[0] = v.r;
+			x[1] = v.g;
+			x[2] = v.b;
+			x += 3;
+		}
+}
+
+void patch_index::compute_basis()
+{
+	int n, k, e, f;
+	int step = vcl_max(1, size() / max_sample);
+	int count = 0;
+	vcl_vector<float> x(d_);
+	vnl_vector<double> mean(d_, 0.0);
+	vnl_matrix<double> cov(d_, d_, 0.0);
+
+	for (n=0; n < size(); n += step) {
+		gather(centers_[2*n], centers_[2*n + 1], &x[0]);
+		for (e=0; e < d_; e++) {
+			mean[e] += x[e];
+			for (f=e; f < d_; f++)
+				cov(e, f) += (double) x[e] * x[f];
+		}
+		count++;
+	}
+
+	mean /= count;
+	for (e=0; e < d_; e++)
+		for (f=e; f < d_; f++) {
+			cov(e, f) = cov(e, f) / count - mean[e] * mean[f];
+			cov(f, e) = cov(e, f);
+		}
+
+// the eigenvalues are sorted in increasing order, so the principal components are the last columns of V
+	vnl_symmetric_eigensystem<double> eig(cov);
+
+	mean_.resize(d_);
+	basis_.resize(dims_ * d_);
+	variance_.resize(dims_);
+	residual_ = 0;
+	for (e=0; e < d_; e++) {
+		mean_[e] = (float) mean[e];
+		residual_ += cov(e, e);
+	}
+	for (k=0; k < dims_; k++) {
+		for (e=0; e < d_; e++)
+			basis_[k*d_ + e] = (float) eig.V(e, d_ - 1 - k);
+		variance_[k] = (float) eig.get_eigenvalue(d_ - 1 - k);
+		residual_ -= variance_[k];
+	}
+	residual_ = vcl_max(residual_ / d_, 1e-3);
+}
+
+void patch_index::compute_descriptors()
+{
+	int n;
+
+	desc_.resize((vcl_size_t) size() * dims_);
+
+#pragma omp parallel if (size() > 4096)
+	{
+		int k, e;
+		vcl_vector<float> x(d_);
+
+#pragma omp for schedule(static)
+		for (n=0; n < size(); n++) {
+			gather(centers_[2*n], centers_[2*n + 1], &x[0]);
+			for (e=0; e < d_; e++)
+				x[e] -= mean_[e];
+
+			for (k=0; k < dims_; k++) {
+				const float* b = &basis_[k*d_];
+				float s = 0;
+				for (e=0; e < d_; e++)
+					s += b[e] * x[e];
+				desc_[(vcl_size_t) n*dims_ + k] = s;
+			}
+		}
+	}
+}
+
+int patch_index::build_tree(int begin, int end)
+{
+	int n, k;
+	int node = nodes_.size();
+
+	nodes_.push_back(kd_node());
+	nodes_[node].dim = -1;
+	nodes_[node].left = begin;
+	nodes_[node].right = end;
+	if (end - begin <= leaf_size)
+		return node;
+
+// split at the median of the coordinate with the largest range
+	int dim = 0;
+	float range = 0;
+	for (k=0; k < dims_; k++) {
+		float lo = desc_[order_[begin]*dims_ + k], hi = lo;
+		for (n=begin+1; n < end; n++) {
+			float v = desc_[order_[n]*dims_ + k];
+			lo = vcl_min(lo, v);
+			hi = vcl_max(hi, v);
+		}
+		if (hi - lo > range) {
+			range = hi - lo;
+			dim = k;
+		}
+	}
+	if (range == 0)
+		return node;
+
+	int mid = (begin + end) / 2;
+	descriptor_less less = { &desc_[0], dims_, dim };
+	vcl_nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end, less);
+
+	float split = desc_[order_[mid]*dims_ + dim];
+	int left = build_tree(begin, mid);
+	int right = build_tree(mid, end);
+
+	nodes_[node].dim = dim;
+	nodes_[node].split = split;
+	nodes_[node].left = left;
+	nodes_[node].right = right;
+	return node;
+}
+
+void patch_index::nearest(const float* q, vcl_vector<int>& found) const
+{
+	int n, k;
+	int leaves = 0;
+
+// best-bin-first: branches not taken wait in a min-heap keyed by their distance to the split
+	typedef vcl_pair<float, int> entry;
+	vcl_vector<entry> queue, best;
+	vcl_greater<entry> later;
+
+	queue.push_back(entry(0.0f, 0));
+	while (!queue.empty()) {
+		vcl_pop_heap(queue.begin(), queue.end(), later);
+		entry top = queue.back();
+		queue.pop_back();
+
+		if (((int) best.size() == candidates_) && (top.first >= best.front().first))
+			break;
+
+		int node = top.second;
+		while (nodes_[node].dim >= 0) {
+			float diff = q[nodes_[node].dim] - nodes_[node].split;
+			int closer = (diff < 0) ? nodes_[node].left : nodes_[node].right;
+			int farther = (diff < 0) ? nodes_[node].right : nodes_[node].left;
+
+			queue.push_back(entry(vcl_max(top.first, diff*diff), farther));
+			vcl_push_heap(queue.begin(), queue.end(), later);
+			node = closer;
+		}
+
+// best is a max-heap of the candidates found so far
+		for (n=nodes_[node].left; n < nodes_[node].right; n++) {
+			const float* p = &desc_[(vcl_size_t) order_[n]*dims_];
+			float dist = 0;
+			for (k=0; k < dims_; k++)
+				dist += (q[k] - p[k]) * (q[k] - p[k]);
+
+			if ((int) best.size() < candidates_) {
+				best.push_back(entry(dist, order_[n]));
+				vcl_push_heap(best.begin(), best.end());
+			} else if (dist < best.front().first) {
+				vcl_pop_heap(best.begin(), best.end());
+				best.back() = entry(dist, order_[n]);
+				vcl_push_heap(best.begin(), best.end());
+			}
+		}
+
+		if ((max_leaves_ > 0) && (++leaves >= max_leaves_))
+			break;
+	}
+
+	found.clear();
+	for (n=0; n < (int) best.size(); n++)
+		found.push_back(best[n].second);
+}
+
+void patch_index::try_patch(const packed_patch& target, int n, long& min, int& match) const
+{
+	int i = centers_[2*n], j = centers_[2*n + 1];
+	long sum = masked_ssd((const vxl_byte*) &im_(i-w_, j-w_), row_step_, false, target, min);
+
+	if ((min < 0) || (sum < min)) {
+		min = sum;
+		match = n;
+	}
+}
+
+bool patch_index::lookup(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int& source_i,
+			int& source_j
+			) const
+{
+	int n, k, l, c, pi, pj;
+	int match = -1;
+	long min = -1;
+	packed_patch target;
+
+// if the data structures were not correctly initialized, quit the lookup operation
+	if ((size() == 0) || (nplanes != nplanes_))
+		return false;
+
+// if the size of the supplied matrices is NOT equal to the patch size, quit the lookup operation
+	for (n=0; n < nplanes; n++)
+		if (((int) target_planes[n].rows() != 2*w_+1) || ((int) target_planes[n].columns() != 2*w_+1))
+			return false;
+
+	target.pack(target_planes, nplanes, target_unfilled);
+
+	int known = 0;
+	for (pi=0; pi <= 2*w_; pi++)
+		for (pj=0; pj <= 2*w_; pj++)
+			if (!target_unfilled(pi, pj))
+				known += nplanes;
+
+	if (known >= min_known_ * d_) {
+// MAP fit of the coefficients to the known samples K:
+//   (B_K^T B_K + residual * diag(1/variance)) c = B_K^T (x_K - mean_K)
+		vnl_matrix<double> A(dims_, dims_, 0.0);
+		vnl_vector<double> b(dims_, 0.0);
+
+		for (pj=0; pj <= 2*w_; pj++)
+			for (pi=0; pi <= 2*w_; pi++) {
+				if (target_unfilled(pi, pj))
+					continue;
+				for (c=0; c < nplanes; c++) {
+					int e = (pj*(2*w_+1) + pi)*nplanes + c;
+					double r = target_planes[c](pi, pj) - mean_[e];
+
+					for (k=0; k < dims_; k++) {
+						double bk = basis_[k*d_ + e];
+						b[k] += bk * r;
+						for (l=k; l < dims_; l++)
+							A(k, l) += bk * basis_[l*d_ + e];
+					}
+				}
+			}
+		for (k=0; k < dims_; k++) {
+			A(k, k) += residual_ / vcl_max(variance_[k], 1e-6f);
+			for (l=0; l < k; l++)
+				A(k, l) = A(l, k);
+		}
+
+		vnl_vector<double> x = vnl_svd<double>(A).solve(b);
+		vcl_vector<float> q(dims_);
+		for (k=0; k < dims_; k++)
+			q[k] = (float) x[k];
+
+		vcl_vector<int> found;
+		nearest(&q[0], found);
+		for (n=0; n < (int) found.size(); n++)
+			try_patch(target, found[n], min, match);
+	}
+
+// too few known samples for a meaningful descriptor: exact search
+	if (match < 0)
+		for (n=0; n < size(); n++)
+			try_patch(target, n, min, match);
+
+	source_i = centers_[2*match];
+	source_j = centers_[2*match + 1];
+
+	return true;
+}
+
+vcl_size_t patch_index::footprint() const
+{
+	return sizeof(*this) +
+		   (vcl_size_t) im_.ni() * im_.nj() * sizeof(vil_rgb<vxl_byte>) +
+		   centers_.capacity() * sizeof(int) +
+		   (mean_.capacity() + basis_.capacity() + desc_.capacity()) * sizeof(float) +
+		   nodes_.capacity() * sizeof(kd_node) +
+		   order_.capacity() * sizeof(int);
+}
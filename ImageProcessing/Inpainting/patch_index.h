@@ -0,0 +1,104 @@
+#ifndef PATCH_INDEX_H
+#define PATCH_INDEX_H
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+#include <vnl/vnl_matrix.h>
+#include <vcl_vector.h>
+#include <vcl_cstddef.h>
+#include "patch_ssd.h"
+
+// Patch lookup through low-dimensional descriptors and a k-d tree
+//
+// Every full source patch, a vector of d = nplanes*(2w+1)^2 bytes, is projected onto the first dims principal
+// components of a sample of the source patches, and the descriptors are indexed by a k-d tree. A lookup
+// computes the descriptor of the target patch, retrieves the candidates nearest source descriptors and re-ranks
+// them with the exact masked SSD, so the result is the best of the candidates rather than the best of the whole
+// database.
+//
+// The target patch is only partially known. Its descriptor is fitted to the known samples alone, as the MAP
+// estimate of the coefficients under the PCA model: each coefficient has the variance of its component and each
+// sample an independent error with the variance left out by the truncated basis. Poorly constrained coefficients
+// thus shrink towards the mean patch instead of overfitting the known half. When fewer than min_known() of the
+// samples are known the lookup falls back to the exact search over all source patches.
+class patch_index {
+public:
+	patch_index(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			const vil_image_view<bool>& unfilled, int patch_radius,
+			int dims = 16, int candidates = 16
+			);
+
+// same interface and result quality as patch_db::lookup(), up to the approximation described above
+	bool lookup(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int& source_i,
+			int& source_j
+			) const;
+
+// fraction of known samples below which a lookup is exact
+	void set_min_known(double fraction) { min_known_ = fraction; }
+	double min_known() const { return min_known_; }
+
+// maximum number of k-d tree leaves visited per lookup; 0 makes the nearest-neighbour search exact
+	void set_max_leaves(int n) { max_leaves_ = n; }
+
+// number of full source patches and dimension of their descriptors
+	int size() const { return (int) centers_.size() / 2; }
+	int dims() const { return dims_; }
+
+// memory used by the index, in bytes
+	vcl_size_t footprint() const;
+
+private:
+// principal components of (at most max_sample) source patches
+	void compute_basis();
+
+	void compute_descriptors();
+	int build_tree(int begin, int end);
+
+// gathers the patch of im_ centered at (i,j) as a vector of d floats (row w+pj, column w+pi, plane)
+	void gather(int i, int j, float* x) const;
+
+// indices of the (at most) candidates_ source descriptors nearest to q
+	void nearest(const float* q, vcl_vector<int>& found) const;
+
+// evaluates source patch n and updates the best match if its distance is smaller than min
+	void try_patch(const packed_patch& target, int n, long& min, int& match) const;
+
+	struct kd_node {
+		int dim;			// split dimension, -1 for a leaf
+		float split;
+		int left, right;	// children, or the range [left, right) of order_ for a leaf
+	};
+
+	int w_;
+	int nplanes_;
+	int d_;
+	int dims_;
+	int candidates_;
+	double min_known_;
+	int max_leaves_;
+
+	vil_image_view<vil_rgb<vxl_byte> > im_;
+	vcl_ptrdiff_t row_step_;
+	vcl_vector<int> centers_;
+
+// mean patch and principal components, dims_ rows of d_ values
+	vcl_vector<float> mean_;
+	vcl_vector<float> basis_;
+
+// variance of the data along each component, and mean variance per sample not explained by the basis
+	vcl_vector<float> variance_;
+	double residual_;
+
+// descriptors of the source patches, dims_ values each
+	vcl_vector<float> desc_;
+
+	vcl_vector<kd_node> nodes_;
+	vcl_vector<int> order_;
+};
+
+#endif
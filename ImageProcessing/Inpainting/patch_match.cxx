@@ -0,0 +1,204 @@
+#include "patch_match.h"
+#include <vil/vil_copy.h>
+#include "mask_sat.h"
+#include <vcl_algorithm.h>
+
+patch_match::patch_match(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			vil_image_view<bool> unfilled, int patch_radius,
+			int quality
+			)
+{
+	w_ = patch_radius;
+	nplanes_ = 3;
+	target_i_ = -1;
+	target_j_ = -1;
+	set_quality(quality);
+
+// create a local copy of the source image
+	vil_copy_deep(im, im_);
+	row_step_ = im_.jstep() * sizeof(vil_rgb<vxl_byte>);
+
+// the nearest-neighbour field is empty until the first lookup
+	off_i_.set_size(im.ni(), im.nj());
+	off_j_.set_size(im.ni(), im.nj());
+	has_off_.set_size(im.ni(), im.nj());
+	has_off_.fill(false);
+
+	compute_patch_centers(im, unfilled);
+}
+
+void patch_match::compute_patch_centers(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			vil_image_view<bool> uf
+			)
+{
+	int n;
+	vcl_vector<int> centers;
+
+	full_.set_size(im.ni(), im.nj());
+	full_.fill(false);
+	centers_i_.clear();
+	centers_j_.clear();
+
+// same set as patch_db::compute_patch_centers(), but we also keep a per-pixel map
+// so that candidates produced by propagation and random search can be validated in O(1)
+	full_patch_centers(uf, w_, centers);
+	for (n=0; n < (int) centers.size(); n += 2) {
+		full_(centers[n], centers[n+1]) = true;
+		centers_i_.push_back(centers[n]);
+		centers_j_.push_back(centers[n+1]);
+	}
+}
+
+void patch_match::set_quality(int quality)
+{
+	quality_ = (quality < 1) ? 1 : quality;
+}
+
+void patch_match::set_target(int target_i, int target_j)
+{
+	target_i_ = target_i;
+	target_j_ = target_j;
+}
+
+bool patch_match::valid_center(int i, int j) const
+{
+	return (i >= w_) && (j >= w_) &&
+		   (i < (int) full_.ni() - w_) && (j < (int) full_.nj() - w_) &&
+		   full_(i, j);
+}
+
+void patch_match::try_center(
+			const packed_patch& target,
+			int i, int j,
+			long& min, int& best_i, int& best_j
+			)
+{
+	long sum;
+
+	if (!valid_center(i, j))
+		return;
+
+// masked SSD between the target patch and the source patch centered at (i,j),
+// abandoned as soon as the current best match cannot be beaten anymore
+	sum = masked_ssd((const vxl_byte*) &im_(i-w_, j-w_), row_step_, false, target, min);
+
+	if ((min < 0) || (sum < min)) {
+		min = sum;
+		best_i = i;
+		best_j = j;
+	}
+}
+
+bool patch_match::lookup(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int target_i,
+			int target_j,
+			int& source_i,
+			int& source_j
+			)
+{
+	set_target(target_i, target_j);
+	return lookup(target_planes, nplanes, target_unfilled, source_i, source_j);
+}
+
+bool patch_match::lookup(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int& source_i,
+			int& source_j
+			)
+{
+	int i, j, n, r;
+	int pi, pj;
+	int best_i = -1, best_j = -1;
+	long min = -1;
+	packed_patch target;
+
+// if the data structures were not correctly initialized, quit the lookup operation
+	if (centers_i_.size() == 0)
+		return false;
+
+// if the size of the supplied matrices is NOT equal to the patch size, quit the lookup operation
+	for (i=0; i < nplanes; i++)
+		if (((int) target_planes[i].rows() != 2*w_+1) || ((int) target_planes[i].columns() != 2*w_+1))
+			return false;
+
+	target.pack(target_planes, nplanes, target_unfilled);
+
+// (1) propagation: try the source patches that the filled pixels of the target patch were copied from
+	if (target_i_ >= 0) {
+		vcl_vector<int> tried_i, tried_j;
+
+		for (pi= -w_; pi <= w_; pi++)
+			for (pj= -w_; pj <= w_; pj++) {
+				i = target_i_ + pi;
+				j = target_j_ + pj;
+				if ((i < 0) || (j < 0) || (i >= (int) has_off_.ni()) || (j >= (int) has_off_.nj()) || !has_off_(i, j))
+					continue;
+
+// candidate source center = target center + offset stored at this pixel
+				int ci = target_i_ + off_i_(i, j);
+				int cj = target_j_ + off_j_(i, j);
+
+// neighbouring pixels usually share the same offset, so skip the ones we have already evaluated
+				for (n=0; n < (int) tried_i.size(); n++)
+					if ((tried_i[n] == ci) && (tried_j[n] == cj))
+						break;
+				if (n < (int) tried_i.size())
+					continue;
+				tried_i.push_back(ci);
+				tried_j.push_back(cj);
+
+				try_center(target, ci, cj, min, best_i, best_j);
+			}
+	}
+
+// (2) a few source patches drawn uniformly from the whole database, to escape poor local optima
+	for (n=0; n < 2*quality_; n++) {
+		int k = rand_.lrand32(0, size()-1);
+		try_center(target, centers_i_[k], centers_j_[k], min, best_i, best_j);
+	}
+
+// (3) random search around the best match found so far at exponentially decreasing radii
+	for (r = vcl_max(im_.ni(), im_.nj()); r >= 1; r /= 2)
+		for (n=0; n < quality_; n++)
+			try_center(target,
+					   best_i + rand_.lrand32(-r, r), best_j + rand_.lrand32(-r, r),
+					   min, best_i, best_j);
+
+	source_i = best_i;
+	source_j = best_j;
+
+	if (target_i_ >= 0)
+		record_offsets(target_unfilled, source_i, source_j);
+
+// the target is consumed by the lookup, so a later lookup without set_target() does not propagate stale offsets
+	target_i_ = -1;
+	target_j_ = -1;
+
+	return true;
+}
+
+void patch_match::record_offsets(const vnl_matrix<int>& target_unfilled, int source_i, int source_j)
+{
+	int pi, pj, i, j;
+
+	for (pi= -w_; pi <= w_; pi++)
+		for (pj= -w_; pj <= w_; pj++) {
+			i = target_i_ + pi;
+			j = target_j_ + pj;
+			if ((i < 0) || (j < 0) || (i >= (int) has_off_.ni()) || (j >= (int) has_off_.nj()))
+				continue;
+// only the unfilled pixels of the target patch will be copied from the source patch
+			if (target_unfilled(w_+pi, w_+pj)) {
+				off_i_(i, j) = source_i - target_i_;
+				off_j_(i, j) = source_j - target_j_;
+				has_off_(i, j) = true;
+			}
+		}
+}
@@ -0,0 +1,102 @@
+#ifndef PATCH_MATCH_H
+#define PATCH_MATCH_H
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_random.h>
+#include <vcl_vector.h>
+#include "patch_ssd.h"
+
+// Approximate nearest-neighbour patch lookup based on PatchMatch (Barnes et al., SIGGRAPH 2009)
+//
+// The class answers the same queries as patch_db::lookup(), but instead of comparing the target patch against
+// every full source patch it only evaluates
+//   (1) the source patches that already-filled pixels of the target patch were copied from (propagation)
+//   (2) a few randomly drawn source patches around the current best match, at exponentially shrinking radii (random search)
+//
+// Every successful lookup records the offset (source - target) for the unfilled pixels of the target patch, since
+// those are the pixels that will be pasted from the source patch. Later target patches that overlap them propagate
+// these offsets, so coherent regions are found with a handful of SSD evaluations instead of top_ of them.
+//
+// The quality parameter is the number of random samples drawn at each search radius (and, times two, the number of
+// global random seeds). quality=1 is fastest; quality around 8 is usually indistinguishable from exhaustive search.
+class patch_match {
+public:
+	patch_match(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			vil_image_view<bool> unfilled, int patch_radius,
+			int quality = 4
+			);
+
+// set the center of the target patch used by the next lookup(); (-1,-1) disables propagation
+	void set_target(int target_i, int target_j);
+
+// same interface as patch_db::lookup(); the target patch center is the one given by set_target()
+	bool lookup(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int& source_i,
+			int& source_j
+			);
+
+// convenience routine equivalent to set_target() followed by lookup()
+	bool lookup(
+			const vnl_matrix<int>* target_planes,
+			int nplanes,
+			const vnl_matrix<int>& target_unfilled,
+			int target_i,
+			int target_j,
+			int& source_i,
+			int& source_j
+			);
+
+	void set_quality(int quality);
+	int quality() const { return quality_; }
+
+// number of full source patches available for lookup operations
+	int size() const { return (int) centers_i_.size(); }
+
+private:
+	void compute_patch_centers(
+			const vil_image_view<vil_rgb<vxl_byte> >& im,
+			vil_image_view<bool> uf
+			);
+
+// returns true if (i,j) is the center of a full source patch
+	bool valid_center(int i, int j) const;
+
+// evaluates the source patch centered at (i,j) and updates the best match if its distance is smaller than min
+	void try_center(
+			const packed_patch& target,
+			int i, int j,
+			long& min, int& best_i, int& best_j
+			);
+
+// stores the offset of the chosen source patch for all unfilled pixels of the target patch
+	void record_offsets(const vnl_matrix<int>& target_unfilled, int source_i, int source_j);
+
+	int w_;
+	int nplanes_;
+	int quality_;
+	int target_i_, target_j_;
+
+	vil_image_view<vil_rgb<vxl_byte> > im_;
+// distance in bytes between consecutive patch columns of im_
+	vcl_ptrdiff_t row_step_;
+
+// full_(i,j) is true if the patch centered at (i,j) contains no unfilled pixels
+	vil_image_view<bool> full_;
+	vcl_vector<int> centers_i_;
+	vcl_vector<int> centers_j_;
+
+// nearest-neighbour field: offset from a target pixel to the pixel it was copied from
+	vil_image_view<int> off_i_;
+	vil_image_view<int> off_j_;
+	vil_image_view<bool> has_off_;
+
+	vnl_random rand_;
+};
+
+#endif
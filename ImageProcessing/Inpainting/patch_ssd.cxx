@@ -0,0 +1,154 @@
+#include "patch_ssd.h"
+#include <vcl_algorithm.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+packed_patch::packed_patch()
+{
+	rows_ = 0;
+	len_ = 0;
+}
+
+int packed_patch::stride(int w, int nplanes, patch_layout layout)
+{
+	return (layout == PATCH_INTERLEAVED) ? nplanes * (2*w+1) : (2*w+1);
+}
+
+int packed_patch::bytes(int w, int nplanes, patch_layout)
+{
+	return (nplanes * (2*w+1) * (2*w+1) + 31) & ~31;
+}
+
+void packed_patch::pack(
+			const vnl_matrix<int>* target_planes, int nplanes, const vnl_matrix<int>& target_unfilled,
+			patch_layout layout
+			)
+{
+	int r, k, plane, v, pos;
+	int sz = target_unfilled.rows();
+
+	if (layout == PATCH_INTERLEAVED) {
+		rows_ = sz;
+		len_ = nplanes * sz;
+	} else {
+		rows_ = nplanes * sz;
+		len_ = sz;
+	}
+
+// padding bytes keep a zero mask so that they never contribute to the sum
+	data_.assign((rows_ * len_ + 31) & ~31, 0);
+	mask_.assign((rows_ * len_ + 31) & ~31, 0);
+
+	for (r=0; r < sz; r++)
+		for (k=0; k < sz; k++) {
+			if (target_unfilled(k, r))
+				continue;
+			for (plane=0; plane < nplanes; plane++) {
+				v = target_planes[plane](k, r);
+				if (v < 0)
+					v = 0;
+				else if (v > 255)
+					v = 255;
+
+				if (layout == PATCH_INTERLEAVED)
+					pos = r*len_ + nplanes*k + plane;
+				else
+					pos = (plane*sz + r)*len_ + k;
+				data_[pos] = (vxl_byte) v;
+				mask_[pos] = 0xff;
+			}
+		}
+}
+
+// squared differences of one row, starting at byte k; returns the first byte that was not processed
+static inline int row_ssd_vector(const vxl_byte* s, const vxl_byte* t, const vxl_byte* m, int n, long& sum)
+{
+	int k = 0;
+
+#if defined(__AVX2__)
+	__m256i zero = _mm256_setzero_si256();
+	__m256i acc = _mm256_setzero_si256();
+
+	for (; k + 32 <= n; k += 32) {
+		__m256i vs = _mm256_loadu_si256((const __m256i*) (s + k));
+		__m256i vt = _mm256_loadu_si256((const __m256i*) (t + k));
+		__m256i vm = _mm256_loadu_si256((const __m256i*) (m + k));
+// |s-t| on unsigned bytes, with unfilled target pixels zeroed by the mask
+		__m256i d = _mm256_and_si256(vm, _mm256_or_si256(_mm256_subs_epu8(vs, vt), _mm256_subs_epu8(vt, vs)));
+		__m256i lo = _mm256_unpacklo_epi8(d, zero);
+		__m256i hi = _mm256_unpackhi_epi8(d, zero);
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(lo, lo));
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(hi, hi));
+	}
+	__m128i acc4 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+#elif defined(__SSE2__)
+	__m128i acc4 = _mm_setzero_si128();
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+	__m128i zero4 = _mm_setzero_si128();
+
+	for (; k + 16 <= n; k += 16) {
+		__m128i vs = _mm_loadu_si128((const __m128i*) (s + k));
+		__m128i vt = _mm_loadu_si128((const __m128i*) (t + k));
+		__m128i vm = _mm_loadu_si128((const __m128i*) (m + k));
+		__m128i d = _mm_and_si128(vm, _mm_or_si128(_mm_subs_epu8(vs, vt), _mm_subs_epu8(vt, vs)));
+		__m128i lo = _mm_unpacklo_epi8(d, zero4);
+		__m128i hi = _mm_unpackhi_epi8(d, zero4);
+		acc4 = _mm_add_epi32(acc4, _mm_madd_epi16(lo, lo));
+		acc4 = _mm_add_epi32(acc4, _mm_madd_epi16(hi, hi));
+	}
+
+	int lanes[4];
+	_mm_storeu_si128((__m128i*) lanes, acc4);
+	sum += (long) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+	return k;
+}
+
+long masked_ssd(
+			const vxl_byte* src,
+			vcl_ptrdiff_t src_step,
+			bool src_padded,
+			const packed_patch& target,
+			long limit
+			)
+{
+	int r, k, d;
+	long sum = 0;
+	int len = target.row_length();
+	int rows = target.rows();
+
+// a packed source has the rows of the target at the same pitch, so the whole padded patch is one stream, cut into
+// blocks of about one row of whole vectors; the zero mask takes care of the padding after the last row
+	if (src_padded) {
+		len = (len + 31) & ~31;
+		rows = (target.bytes() + len - 1) / len;
+	}
+
+	for (r=0; r < rows; r++) {
+		const vxl_byte* s = src + (src_padded ? r*len : r*src_step);
+		const vxl_byte* t = target.data() + r*len;
+		const vxl_byte* m = target.mask() + r*len;
+		int n = src_padded ? vcl_min(len, target.bytes() - r*len) : len;
+
+		k = row_ssd_vector(s, t, m, n, sum);
+
+// scalar tail (and the whole row if no SIMD instruction set is available)
+		for (; k < n; k++)
+			if (m[k]) {
+				d = (int) s[k] - (int) t[k];
+				sum += d*d;
+			}
+
+// check the partial sum once per row
+		if ((limit >= 0) && (sum > limit))
+			return sum;
+	}
+	return sum;
+}
@@ -0,0 +1,68 @@
+#ifndef PATCH_SSD_H
+#define PATCH_SSD_H
+
+#include <vxl_config.h>
+#include <vnl/vnl_matrix.h>
+#include <vcl_vector.h>
+#include <vcl_cstddef.h>
+
+// Byte layouts of a packed patch of radius w
+//
+//   PATCH_INTERLEAVED: 2w+1 rows of nplanes*(2w+1) bytes; pixel (w+pi, w+pj) is stored in row w+pj at byte
+//                      nplanes*(w+pi)+plane, ie. every row holds one patch column of a vil_image_view<vil_rgb<vxl_byte> >
+//                      exactly as it is laid out in memory
+//   PATCH_PLANAR:      nplanes*(2w+1) rows of 2w+1 bytes; pixel (w+pi, w+pj) is stored in row plane*(2w+1)+w+pj at byte w+pi
+//
+// In both layouts the rows follow each other at their natural length and only the whole patch, nplanes*(2w+1)^2
+// bytes, is padded to a multiple of 32 bytes: for w=4 and 3 planes, 243 bytes take 256.
+enum patch_layout { PATCH_INTERLEAVED, PATCH_PLANAR };
+
+// A target patch packed for the masked SSD kernel
+//
+// The mask is 0xff for known pixels (target_unfilled == 0) and 0 for unfilled pixels and padding.
+class packed_patch {
+public:
+	packed_patch();
+
+	void pack(
+			const vnl_matrix<int>* target_planes, int nplanes, const vnl_matrix<int>& target_unfilled,
+			patch_layout layout = PATCH_INTERLEAVED
+			);
+
+// row length of a patch of radius w in the given layout, and the padded size in bytes of the whole packed patch
+	static int stride(int w, int nplanes, patch_layout layout);
+	static int bytes(int w, int nplanes, patch_layout layout);
+
+	int rows() const { return rows_; }
+	int row_length() const { return len_; }
+	int bytes() const { return (int) data_.size(); }
+
+	const vxl_byte* data() const { return &data_[0]; }
+	const vxl_byte* mask() const { return &mask_[0]; }
+
+private:
+	int rows_;
+	int len_;
+	vcl_vector<vxl_byte> data_;
+	vcl_vector<vxl_byte> mask_;
+};
+
+// Masked sum of squared differences between a packed target patch and a source patch
+//
+// Source row r starts at src + r*src_step and holds target.row_length() bytes in the same layout as the target.
+// If src_padded is true the source is a packed patch (src_step is not used) that may be read up to
+// target.bytes(), so the whole patch is compared as one stream of whole vectors, without a scalar tail. The partial
+// sum is compared against limit after every row (about one row of whole vectors for a packed source): as soon as
+// it exceeds limit the routine returns it, so the result is exact only when it is <= limit. A negative limit
+// disables early termination.
+//
+// Uses AVX2 (32 bytes per step) or SSE2 (16 bytes per step) when the compiler targets them.
+long masked_ssd(
+			const vxl_byte* src,
+			vcl_ptrdiff_t src_step,
+			bool src_padded,
+			const packed_patch& target,
+			long limit
+			);
+
+#endif
@@ -0,0 +1,54 @@
+//
+//  Out-of-core triangulation matting of very large images
+//
+//  usage: banded_matting [-m mb] comp_1 comp_2 back_1 back_2 alpha object
+//      -m mb       memory cap of the band buffers, in megabytes (default: 256)
+//
+//  Writes the alpha matte and the premultiplied foreground of the composites comp_1 and comp_2 over the
+//  backgrounds back_1 and back_2, processing the images in bands of rows (see banded_matte()).
+//
+
+#include "matting_banded.h"
+#include <vcl_iostream.h>
+#include <vcl_cstdlib.h>
+#include <vcl_cstring.h>
+#include <chrono>
+
+static int usage()
+{
+    vcl_cerr << "usage: banded_matting [-m mb] comp_1 comp_2 back_1 back_2 alpha object\n";
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    double mb = 256;
+    int a;
+
+    for (a=1; (a < argc - 1) && (argv[a][0] == '-'); a += 2) {
+        if (!vcl_strcmp(argv[a], "-m"))
+            mb = vcl_atof(argv[a+1]);
+        else
+            return usage();
+    }
+    if ((a != argc - 6) || (mb <= 0))
+        return usage();
+
+    int rows = -1;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    bool ok = banded_matte(argv[a], argv[a+1], argv[a+2], argv[a+3], argv[a+4], argv[a+5],
+                           (vcl_size_t) (mb * 1024 * 1024), &rows);
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    if (!ok && (rows == 0)) {
+        vcl_cerr << "banded_matting: a single row of the images does not fit in " << mb << " MB\n";
+        return 1;
+    }
+    if (!ok) {
+        vcl_cerr << "banded_matting: cannot read the inputs, size or format mismatch, or cannot write the outputs\n";
+        return 1;
+    }
+
+    vcl_cout << "# band_rows time\n" << rows << " " << total << "\n";
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "matting_banded.h"
+#include "matting_solver.h"
+#include <vil/vil_image_resource.h>
+#include <vil/vil_load.h>
+#include <vil/vil_new.h>
+#include <vil/vil_pixel_format.h>
+#include <vcl_algorithm.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+//  Bytes per pixel of a band: the four inputs and the block read from the file before its conversion,
+//  alpha, the foreground and its planar copy for the output
+//
+static const vcl_size_t band_bytes_per_pixel = 4*3 + 3 + 1 + 3 + 3;
+
+// converts the rows [j0,j0+nj) of a colour or gray-level resource to band
+static bool read_band(const vil_image_resource_sptr& res, int j0, int nj, vil_image_view<vil_rgb<vxl_byte> >& band)
+{
+    vil_image_view<vxl_byte> in(res->get_view(0, res->ni(), j0, nj));
+
+    if (!in || ((int) in.nj() != nj))
+        return false;
+
+    band.set_size(in.ni(), nj);
+    for (int j=0; j < nj; j++) {
+        for (int i=0; i < (int) in.ni(); i++) {
+            if (in.nplanes() == 1)
+                band(i,j) = vil_rgb<vxl_byte>(in(i,j), in(i,j), in(i,j));
+            else
+                band(i,j) = vil_rgb<vxl_byte>(in(i,j,0), in(i,j,1), in(i,j,2));
+        }
+    }
+
+    return true;
+}
+
+bool banded_matte(
+        const vcl_string& comp_1, const vcl_string& comp_2,
+        const vcl_string& back_1, const vcl_string& back_2,
+        const vcl_string& alpha_out, const vcl_string& object_out,
+        vcl_size_t max_bytes, int* band_rows)
+{
+    const vcl_string* names[4] = { &comp_1, &comp_2, &back_1, &back_2 };
+    vil_image_resource_sptr in[4];
+    int k;
+
+    for (k=0; k < 4; k++) {
+        in[k] = vil_load_image_resource(names[k]->c_str());
+        if (!in[k] || (in[k]->pixel_format() != VIL_PIXEL_FORMAT_BYTE) ||
+            ((in[k]->nplanes() != 1) && (in[k]->nplanes() < 3)))
+            return false;
+        if ((in[k]->ni() != in[0]->ni()) || (in[k]->nj() != in[0]->nj()))
+            return false;
+    }
+
+    int ni = in[0]->ni(), nj = in[0]->nj();
+    if ((ni == 0) || (nj == 0))
+        return false;
+
+    // the kernel also keeps 12 float rows per thread
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    vcl_size_t fixed = (vcl_size_t) threads * 12 * sizeof(float) * ni;
+    vcl_size_t row = band_bytes_per_pixel * ni;
+    if (max_bytes < fixed + row) {
+        if (band_rows)
+            *band_rows = 0;
+        return false;
+    }
+    int rows = (int) vcl_min((vcl_size_t) nj, (max_bytes - fixed) / row);
+    if (band_rows)
+        *band_rows = rows;
+
+    vil_image_resource_sptr alpha_res = vil_new_image_resource(alpha_out.c_str(), ni, nj, 1, VIL_PIXEL_FORMAT_BYTE);
+    vil_image_resource_sptr object_res = vil_new_image_resource(object_out.c_str(), ni, nj, 3, VIL_PIXEL_FORMAT_BYTE);
+    if (!alpha_res || !object_res)
+        return false;
+
+    vil_image_view<vil_rgb<vxl_byte> > band[4], object;
+    vil_image_view<vxl_byte> alpha, planes;
+
+    for (int j0=0; j0 < nj; j0 += rows) {
+        int h = (j0 + rows <= nj) ? rows : nj - j0;
+
+        for (k=0; k < 4; k++)
+            if (!read_band(in[k], j0, h, band[k]))
+                return false;
+
+        if (!triangulation_matte(band[0], band[1], band[2], band[3], alpha, object, MATTING_VECTORIZED))
+            return false;
+
+        planes.set_size(ni, h, 3);
+        for (int j=0; j < h; j++) {
+            for (int i=0; i < ni; i++) {
+                planes(i,j,0) = object(i,j).r;
+                planes(i,j,1) = object(i,j).g;
+                planes(i,j,2) = object(i,j).b;
+            }
+        }
+
+        if (!alpha_res->put_view(alpha, 0, j0) || !object_res->put_view(planes, 0, j0))
+            return false;
+    }
+
+    return true;
+}
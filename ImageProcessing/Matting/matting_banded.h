@@ -0,0 +1,26 @@
+#ifndef MATTING_BANDED_H
+#define MATTING_BANDED_H
+
+#include <vcl_string.h>
+#include <vcl_cstddef.h>
+
+//
+//  Out-of-core triangulation matting of images too large for memory
+//
+//  The four inputs are read through vil_image_resource in bands of whole rows. Each band is matted with
+//  the vectorized kernel, and the alpha matte (one plane) and the premultiplied foreground (three planes)
+//  are written to the two outputs band by band. The height of the bands is chosen so that the buffers
+//  stay below max_bytes; it is returned in band_rows if given. If even a single row does not fit in
+//  max_bytes, nothing is written, band_rows is set to 0 and the routine fails.
+//
+//  The inputs can be colour or gray-level images of bytes. Only formats whose vil resources read and write
+//  blocks (PNM, TIFF, ...) actually stream; for the others (PNG, JPEG, ...) vil decodes the whole image
+//  on every read. The format of the outputs is guessed from their names.
+//
+bool banded_matte(
+        const vcl_string& comp_1, const vcl_string& comp_2,
+        const vcl_string& back_1, const vcl_string& back_2,
+        const vcl_string& alpha_out, const vcl_string& object_out,
+        vcl_size_t max_bytes, int* band_rows = 0);
+
+#endif
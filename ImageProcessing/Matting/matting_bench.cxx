@@ -0,0 +1,240 @@
+//
+//  Matting throughput benchmark and accuracy check
+//
+//  usage: matting_bench [options]
+//      -r repeats  number of timed runs of every solver; the fastest is reported (default: 3)
+//      -s pixels   largest image the SVD reference solver is run on (default: 76800, i.e. 320x240)
+//      -b error    accuracy budget: a solver fails if its mean alpha error exceeds error 8-bit levels
+//                  (default: 1)
+//      -o file     write the results to file instead of stdout
+//
+//  For every resolution a synthetic ground truth is generated: a foreground with a soft-edged matte
+//  (opaque core, linear ramps, a semi-transparent gradient) over two smooth, noisy backgrounds that differ
+//  everywhere, and the two 8-bit composites. Each solver of triangulation_matte() (the solve behind
+//  matting::compute), and the background calibration, is timed on the composites and its alpha and
+//  premultiplied foreground are compared with the ground truth. composite_matte() (behind
+//  matting::compute_composite) is timed over one and over four new backgrounds.
+//
+//  Throughput is in megapixels per second; errors are in 8-bit levels. The exit status is non-zero if a
+//  solver fails or exceeds the accuracy budget.
+//
+
+#include "matting_solver.h"
+#include "matting_calibration.h"
+#include "matting_composite.h"
+#include <vnl/vnl_random.h>
+#include <vcl_iostream.h>
+#include <vcl_fstream.h>
+#include <vcl_iomanip.h>
+#include <vcl_cmath.h>
+#include <vcl_cstdlib.h>
+#include <vcl_cstring.h>
+#include <vcl_algorithm.h>
+#include <chrono>
+
+typedef vil_image_view<vil_rgb<vxl_byte> > rgb_image;
+
+struct bench_size {
+    int ni, nj;
+};
+
+struct bench_truth {
+    vil_image_view<double> alpha;       // in [0,1]
+    rgb_image foreground;               // not premultiplied
+    rgb_image back_1, back_2, comp_1, comp_2;
+};
+
+static vxl_byte to_byte(double v)
+{
+    return (vxl_byte) vcl_max(0.0, vcl_min(255.0, vcl_floor(v + 0.5)));
+}
+
+static void synthetic_truth(int ni, int nj, bench_truth& t)
+{
+    vnl_random rand(9667566);
+
+    t.alpha.set_size(ni, nj);
+    t.foreground.set_size(ni, nj);
+    t.back_1.set_size(ni, nj);
+    t.back_2.set_size(ni, nj);
+    t.comp_1.set_size(ni, nj);
+    t.comp_2.set_size(ni, nj);
+
+    // the geometry scales with the image, so that every resolution sees the same scene
+    double ci = 0.4 * ni, cj = 0.5 * nj, r = 0.3 * vcl_min(ni, nj), ramp = 0.05 * vcl_min(ni, nj) + 1;
+
+    for (int j=0; j < nj; j++) {
+        for (int i=0; i < ni; i++) {
+            double x = (double) i / ni, y = (double) j / nj;
+
+            // a disc with a linear ramp at its edge, and a semi-transparent band on the right
+            double d = vcl_sqrt((i - ci)*(i - ci) + (j - cj)*(j - cj));
+            double a = vcl_max(0.0, vcl_min(1.0, (r - d) / ramp));
+            if (x > 0.75)
+                a = vcl_max(a, 0.8 * (1 - vcl_fabs(y - 0.5) * 2));
+            t.alpha(i,j) = a;
+
+            t.foreground(i,j) = vil_rgb<vxl_byte>(to_byte(200 + 50*vcl_sin(9*x)), to_byte(120 + 60*vcl_cos(7*y)),
+                                                  to_byte(60 + 40*vcl_sin(5*(x + y))));
+            t.back_1(i,j) = vil_rgb<vxl_byte>(to_byte(30 + 20*y + rand.drand32(-8, 8)), to_byte(190 + 40*x + rand.drand32(-8, 8)),
+                                              to_byte(40 + rand.drand32(-8, 8)));
+            t.back_2(i,j) = vil_rgb<vxl_byte>(to_byte(40 + 20*x + rand.drand32(-8, 8)), to_byte(50 + rand.drand32(-8, 8)),
+                                              to_byte(180 + 50*y + rand.drand32(-8, 8)));
+
+            const vil_rgb<vxl_byte>& f = t.foreground(i,j);
+            const vil_rgb<vxl_byte>& b1 = t.back_1(i,j);
+            const vil_rgb<vxl_byte>& b2 = t.back_2(i,j);
+            t.comp_1(i,j) = vil_rgb<vxl_byte>(to_byte(a*f.r + (1 - a)*b1.r), to_byte(a*f.g + (1 - a)*b1.g),
+                                              to_byte(a*f.b + (1 - a)*b1.b));
+            t.comp_2(i,j) = vil_rgb<vxl_byte>(to_byte(a*f.r + (1 - a)*b2.r), to_byte(a*f.g + (1 - a)*b2.g),
+                                              to_byte(a*f.b + (1 - a)*b2.b));
+        }
+    }
+}
+
+//
+//  Mean and maximum error of alpha (against 255*alpha) and mean error of the premultiplied foreground
+//
+static void matte_error(
+        const bench_truth& t,
+        const vil_image_view<vxl_byte>& alpha,
+        const rgb_image& object,
+        double& alpha_mean, double& alpha_max, double& fg_mean)
+{
+    int ni = t.alpha.ni(), nj = t.alpha.nj();
+    double sa = 0, sf = 0;
+
+    alpha_max = 0;
+    for (int j=0; j < nj; j++) {
+        for (int i=0; i < ni; i++) {
+            double a = t.alpha(i,j);
+            double e = vcl_fabs(alpha(i,j) - 255*a);
+            const vil_rgb<vxl_byte>& f = t.foreground(i,j);
+
+            sa += e;
+            alpha_max = vcl_max(alpha_max, e);
+            sf += vcl_fabs(object(i,j).r - a*f.r) + vcl_fabs(object(i,j).g - a*f.g) + vcl_fabs(object(i,j).b - a*f.b);
+        }
+    }
+
+    alpha_mean = sa / ((double) ni * nj);
+    fg_mean = sf / (3.0 * ni * nj);
+}
+
+static double seconds_since(const std::chrono::steady_clock::time_point& t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static int usage()
+{
+    vcl_cerr << "usage: matting_bench [-r repeats] [-s svd_pixels] [-b error] [-o file]\n";
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    int repeats = 3;
+    long svd_pixels = 320*240;
+    double budget = 1;
+    const char* out_fname = 0;
+    int a, n, r;
+
+    for (a=1; a < argc - 1; a += 2) {
+        if (!vcl_strcmp(argv[a], "-r"))
+            repeats = vcl_max(1, vcl_atoi(argv[a+1]));
+        else if (!vcl_strcmp(argv[a], "-s"))
+            svd_pixels = vcl_atol(argv[a+1]);
+        else if (!vcl_strcmp(argv[a], "-b"))
+            budget = vcl_atof(argv[a+1]);
+        else if (!vcl_strcmp(argv[a], "-o"))
+            out_fname = argv[a+1];
+        else
+            return usage();
+    }
+    if (a != argc)
+        return usage();
+
+    bench_size sizes[] = { { 320, 240 }, { 1280, 720 }, { 1920, 1080 } };
+    int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    // the solvers; calibrated is matting_calibration, the others are solvers of triangulation_matte()
+    const char* names[] = { "svd", "closed_form", "vectorized", "calibrated" };
+    matting_solver solvers[] = { MATTING_SVD, MATTING_CLOSED_FORM, MATTING_VECTORIZED, MATTING_VECTORIZED };
+    int nsolvers = sizeof(names) / sizeof(names[0]);
+
+    vcl_ofstream file;
+    if (out_fname)
+        file.open(out_fname);
+    vcl_ostream& out = out_fname ? (vcl_ostream&) file : vcl_cout;
+
+    out << vcl_fixed << vcl_setprecision(3);
+    out << "# size solver status seconds mp_per_s alpha_mean alpha_max fg_mean\n";
+
+    int status = 0;
+    for (n=0; n < nsizes; n++) {
+        int ni = sizes[n].ni, nj = sizes[n].nj;
+        double mp = ni * (double) nj / 1e6;
+        bench_truth t;
+
+        synthetic_truth(ni, nj, t);
+
+        vil_image_view<vxl_byte> alpha;
+        rgb_image object;
+
+        for (int s=0; s < nsolvers; s++) {
+            out << ni << "x" << nj << " " << names[s] << " ";
+            if ((solvers[s] == MATTING_SVD) && ((long) ni * nj > svd_pixels)) {
+                out << "skipped\n";
+                continue;
+            }
+
+            // the calibration is made once per pair of backgrounds and is not timed
+            matting_calibration calibration(t.back_1, t.back_2);
+
+            bool ok = true;
+            double best = 0;
+            for (r=0; r < repeats; r++) {
+                std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+                if (s == 3)
+                    ok = calibration.matte(t.comp_1, t.comp_2, alpha, object) && ok;
+                else
+                    ok = triangulation_matte(t.comp_1, t.comp_2, t.back_1, t.back_2, alpha, object, solvers[s]) && ok;
+                double time = seconds_since(t0);
+                best = (r == 0) ? time : vcl_min(best, time);
+            }
+
+            double alpha_mean = 0, alpha_max = 0, fg_mean = 0;
+            if (ok)
+                matte_error(t, alpha, object, alpha_mean, alpha_max, fg_mean);
+            bool pass = ok && (alpha_mean <= budget);
+            if (!pass)
+                status = 1;
+
+            out << (pass ? "ok" : "FAIL") << " " << best << " " << (best > 0 ? mp / best : 0) << " "
+                << alpha_mean << " " << alpha_max << " " << fg_mean << "\n";
+        }
+
+        // compositing the last matte over one, then four new backgrounds (the composites and the plates)
+        rgb_image backs[4] = { t.back_1, t.back_2, t.comp_1, t.comp_2 };
+        rgb_image outputs[4];
+        for (int m=1; m <= 4; m *= 4) {
+            bool ok = true;
+            double best = 0;
+            for (r=0; r < repeats; r++) {
+                std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+                ok = composite_matte(alpha, object, backs, outputs, m) && ok;
+                double time = seconds_since(t0);
+                best = (r == 0) ? time : vcl_min(best, time);
+            }
+            if (!ok)
+                status = 1;
+
+            // mp_per_s counts the composited pixels, over all the backgrounds
+            out << ni << "x" << nj << " composite_" << m << " " << (ok ? "ok" : "FAIL") << " " << best << " "
+                << (best > 0 ? m * mp / best : 0) << " - - -\n";
+        }
+    }
+
+    return status;
+}
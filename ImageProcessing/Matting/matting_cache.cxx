@@ -0,0 +1,149 @@
+#include "matting_cache.h"
+#include "matting_solver.h"
+#include <vcl_algorithm.h>
+
+static bool same_pixel(const vil_rgb<vxl_byte>& a, const vil_rgb<vxl_byte>& b)
+{
+    return (a.r == b.r) && (a.g == b.g) && (a.b == b.b);
+}
+
+// true if the rectangles overlap or touch
+static bool adjacent(const matting_rect& a, const matting_rect& b)
+{
+    return (a.i0 <= b.i1 + 1) && (b.i0 <= a.i1 + 1) && (a.j0 <= b.j1 + 1) && (b.j0 <= a.j1 + 1);
+}
+
+static void grow(matting_rect& a, const matting_rect& b)
+{
+    a.i0 = vcl_min(a.i0, b.i0);
+    a.j0 = vcl_min(a.j0, b.j0);
+    a.i1 = vcl_max(a.i1, b.i1);
+    a.j1 = vcl_max(a.j1, b.j1);
+}
+
+void cached_matte::set_input(matting_input which, const vil_image_view<vil_rgb<vxl_byte> >& im)
+{
+    vil_image_view<vil_rgb<vxl_byte> >& in = inputs_[which];
+    int ni = im.ni(), nj = im.nj();
+
+    if (!in || ((int) in.ni() != ni) || ((int) in.nj() != nj)) {
+        in.set_size(ni, nj);
+        for (int j=0; j < nj; j++)
+            for (int i=0; i < ni; i++)
+                in(i,j) = im(i,j);
+        all_dirty_ = true;
+        return;
+    }
+
+    // copy and find the bounding box of the changed pixels in the same pass
+    matting_rect r = { ni, nj, -1, -1 };
+    for (int j=0; j < nj; j++) {
+        for (int i=0; i < ni; i++) {
+            if (same_pixel(in(i,j), im(i,j)))
+                continue;
+
+            in(i,j) = im(i,j);
+            r.i0 = vcl_min(r.i0, i);
+            r.i1 = vcl_max(r.i1, i);
+            r.j0 = vcl_min(r.j0, j);
+            r.j1 = vcl_max(r.j1, j);
+        }
+    }
+
+    if (r.i1 >= 0)
+        mark(r);
+}
+
+bool cached_matte::set_region(matting_input which, int i0, int j0, const vil_image_view<vil_rgb<vxl_byte> >& patch)
+{
+    vil_image_view<vil_rgb<vxl_byte> >& in = inputs_[which];
+    int ni = patch.ni(), nj = patch.nj();
+
+    if (!in || (i0 < 0) || (j0 < 0) || (i0 + ni > (int) in.ni()) || (j0 + nj > (int) in.nj()))
+        return false;
+    if ((ni == 0) || (nj == 0))
+        return true;
+
+    for (int j=0; j < nj; j++)
+        for (int i=0; i < ni; i++)
+            in(i0 + i, j0 + j) = patch(i,j);
+
+    matting_rect r = { i0, j0, i0 + ni - 1, j0 + nj - 1 };
+    mark(r);
+
+    return true;
+}
+
+void cached_matte::mark(const matting_rect& rect)
+{
+    if (all_dirty_)
+        return;
+
+    // absorb the rectangles that the new one overlaps, until it overlaps none
+    matting_rect r = rect;
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (unsigned k=0; k < dirty_.size(); k++) {
+            if (adjacent(dirty_[k], r)) {
+                grow(r, dirty_[k]);
+                dirty_.erase(dirty_.begin() + k);
+                merged = true;
+                break;
+            }
+        }
+    }
+    dirty_.push_back(r);
+
+    if ((int) dirty_.size() > max_rects) {
+        for (unsigned k=1; k < dirty_.size(); k++)
+            grow(dirty_[0], dirty_[k]);
+        dirty_.resize(1);
+    }
+}
+
+long cached_matte::dirty_pixels() const
+{
+    if (all_dirty_)
+        return (long) inputs_[MATTING_COMP_1].ni() * inputs_[MATTING_COMP_1].nj();
+
+    long n = 0;
+    for (unsigned k=0; k < dirty_.size(); k++)
+        n += (long) (dirty_[k].i1 - dirty_[k].i0 + 1) * (dirty_[k].j1 - dirty_[k].j0 + 1);
+    return n;
+}
+
+bool cached_matte::compute()
+{
+    int ni = inputs_[0].ni(), nj = inputs_[0].nj();
+
+    for (int k=0; k < 4; k++)
+        if (!inputs_[k] || ((int) inputs_[k].ni() != ni) || ((int) inputs_[k].nj() != nj))
+            return false;
+
+    if ((ni != ni_) || (nj != nj_))
+        all_dirty_ = true;
+
+    if (all_dirty_) {
+        if (!triangulation_matte(inputs_[MATTING_COMP_1], inputs_[MATTING_COMP_2],
+                                 inputs_[MATTING_BACK_1], inputs_[MATTING_BACK_2],
+                                 alpha_, object_, MATTING_VECTORIZED))
+            return false;
+        ni_ = ni;
+        nj_ = nj;
+    } else {
+        for (unsigned k=0; k < dirty_.size(); k++) {
+            const matting_rect& r = dirty_[k];
+            if (!triangulation_matte_region(inputs_[MATTING_COMP_1], inputs_[MATTING_COMP_2],
+                                            inputs_[MATTING_BACK_1], inputs_[MATTING_BACK_2],
+                                            r.i0, r.j0, r.i1 - r.i0 + 1, r.j1 - r.j0 + 1,
+                                            alpha_, object_))
+                return false;
+        }
+    }
+
+    all_dirty_ = false;
+    dirty_.clear();
+
+    return true;
+}
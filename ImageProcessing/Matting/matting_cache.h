@@ -0,0 +1,64 @@
+#ifndef MATTING_CACHE_H
+#define MATTING_CACHE_H
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+#include <vcl_vector.h>
+
+enum matting_input {
+    MATTING_COMP_1,
+    MATTING_COMP_2,
+    MATTING_BACK_1,
+    MATTING_BACK_2
+};
+
+// rectangle [i0,i1]x[j0,j1]
+struct matting_rect {
+    int i0, j0, i1, j1;
+};
+
+//
+//  Triangulation matte that tracks the regions of its inputs that changed since the last compute()
+//  and only solves those again, for interactive retouching of the plates
+//
+//  The setters keep their own copy of the inputs. set_input() marks the bounding box of the pixels
+//  that differ from the previous image dirty (everything if the size changed), set_region() only the
+//  region it overwrites. Up to max_rects disjoint dirty rectangles are kept; beyond that they are merged
+//  into their bounding box.
+//
+class cached_matte {
+public:
+    cached_matte() : ni_(0), nj_(0), all_dirty_(true) {}
+
+    void set_input(matting_input which, const vil_image_view<vil_rgb<vxl_byte> >& im);
+
+    // copies patch into the input at (i0,j0); fails if it does not fit inside the input
+    bool set_region(matting_input which, int i0, int j0, const vil_image_view<vil_rgb<vxl_byte> >& patch);
+
+    // solves the dirty pixels (all of them after a change of size) with the vectorized kernel. Fails if
+    // an input is missing or their sizes differ
+    bool compute();
+
+    // number of pixels the next compute() will solve
+    long dirty_pixels() const;
+
+    const vil_image_view<vxl_byte>& alpha() const { return alpha_; }
+    const vil_image_view<vil_rgb<vxl_byte> >& object() const { return object_; }
+
+    static const int max_rects = 8;
+
+private:
+    void mark(const matting_rect& r);
+
+    vil_image_view<vil_rgb<vxl_byte> > inputs_[4];
+    vil_image_view<vxl_byte> alpha_;
+    vil_image_view<vil_rgb<vxl_byte> > object_;
+
+    // size of the current matte
+    int ni_, nj_;
+
+    bool all_dirty_;
+    vcl_vector<matting_rect> dirty_;
+};
+
+#endif
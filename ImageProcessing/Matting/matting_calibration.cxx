@@ -0,0 +1,205 @@
+#include "matting_calibration.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+matting_calibration::matting_calibration(
+        const vil_image_view<vil_rgb<vxl_byte> >& back_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_2)
+    : ni_(0), nj_(0)
+{
+    if ((back_1.ni() != back_2.ni()) || (back_1.nj() != back_2.nj()))
+        return;
+
+    ni_ = back_1.ni();
+    nj_ = back_1.nj();
+    coeffs_.resize(6 * (vcl_size_t) ni_ * nj_);
+    equal_start_.resize(nj_ + 1, 0);
+
+    for (int j=0; j < nj_; j++) {
+        float* c = &coeffs_[6 * (vcl_size_t) ni_ * j];
+
+        for (int i=0; i < ni_; i++) {
+            const vil_rgb<vxl_byte>& b1 = back_1(i,j);
+            const vil_rgb<vxl_byte>& b2 = back_2(i,j);
+            double db[3];
+            db[0] = (int) b1.r - (int) b2.r;
+            db[1] = (int) b1.g - (int) b2.g;
+            db[2] = (int) b1.b - (int) b2.b;
+            double s[3] = { 0.5 * ((int) b1.r + (int) b2.r), 0.5 * ((int) b1.g + (int) b2.g), 0.5 * ((int) b1.b + (int) b2.b) };
+            double nb = db[0]*db[0] + db[1]*db[1] + db[2]*db[2];
+            double bn = s[0]*s[0] + s[1]*s[1] + s[2]*s[2];
+
+            for (int k=0; k < 3; k++) {
+                c[k*ni_ + i] = (float) ((nb > 0) ? db[k] / nb : -s[k] / (2 * (bn + 1)));
+                c[(3+k)*ni_ + i] = (float) s[k];
+            }
+            if (nb == 0) {
+                equal_i_.push_back(i);
+                equal_a0_.push_back((float) (bn / (bn + 1)));
+            }
+        }
+        equal_start_[j+1] = (int) equal_i_.size();
+    }
+}
+
+//
+//  One pixel of the row: alpha = a0 + (C2 + sign C1).d, with a0 = 1 and sign = -1 where the backgrounds
+//  differ, and sign = +1 where they are equal
+//
+static void calibrated_pixel(
+        const float* comp, const float* coeffs, int n, int i, float a0, float sign,
+        vxl_byte* alpha, vil_rgb<vxl_byte>* object)
+{
+    int k;
+    float a = a0;
+
+    for (k=0; k < 3; k++)
+        a += (comp[(3+k)*n + i] + sign * comp[k*n + i]) * coeffs[k*n + i];
+
+    int f[3];
+    for (k=0; k < 3; k++) {
+        float v = 0.5f * (comp[k*n + i] + comp[(3+k)*n + i]) - (1.0f - a) * coeffs[(3+k)*n + i];
+        f[k] = (int) ((v < 0) ? 0 : ((v > 255) ? 255 : v));
+    }
+    a = (a < 0) ? 0 : ((a > 1) ? 1 : a);
+
+    alpha[i] = (vxl_byte) (a * 255);
+    object[i] = vil_rgb<vxl_byte>(f[0], f[1], f[2]);
+}
+
+//
+//  Kernel: comp holds the planar float rows C1 r,g,b, C2 r,g,b of n pixels and coeffs the calibration
+//  rows of the same pixels; the pixels with equal backgrounds are re-solved by the caller
+//
+static void calibrated_row(const float* comp, const float* coeffs, int n, vxl_byte* alpha, vil_rgb<vxl_byte>* object)
+{
+    int i = 0, k;
+
+#if defined(__AVX2__)
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f), full = _mm256_set1_ps(255.0f);
+    int ia[8], ic[3][8];
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 c1[3], c2[3];
+        __m256 a = one;
+
+        for (k=0; k < 3; k++) {
+            c1[k] = _mm256_loadu_ps(comp + k*n + i);
+            c2[k] = _mm256_loadu_ps(comp + (3+k)*n + i);
+            a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(c2[k], c1[k]), _mm256_loadu_ps(coeffs + k*n + i)));
+        }
+
+        __m256 ma = _mm256_sub_ps(one, a);
+        for (k=0; k < 3; k++) {
+            __m256 f = _mm256_sub_ps(_mm256_mul_ps(half, _mm256_add_ps(c1[k], c2[k])),
+                                     _mm256_mul_ps(ma, _mm256_loadu_ps(coeffs + (3+k)*n + i)));
+            _mm256_storeu_si256((__m256i*) ic[k], _mm256_cvttps_epi32(_mm256_min_ps(full, _mm256_max_ps(zero, f))));
+        }
+        _mm256_storeu_si256((__m256i*) ia, _mm256_cvttps_epi32(_mm256_mul_ps(full, _mm256_min_ps(one, _mm256_max_ps(zero, a)))));
+
+        for (k=0; k < 8; k++) {
+            alpha[i+k] = (vxl_byte) ia[k];
+            object[i+k] = vil_rgb<vxl_byte>(ic[0][k], ic[1][k], ic[2][k]);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f), full = _mm_set1_ps(255.0f);
+    int ia[4], ic[3][4];
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 c1[3], c2[3];
+        __m128 a = one;
+
+        for (k=0; k < 3; k++) {
+            c1[k] = _mm_loadu_ps(comp + k*n + i);
+            c2[k] = _mm_loadu_ps(comp + (3+k)*n + i);
+            a = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(c2[k], c1[k]), _mm_loadu_ps(coeffs + k*n + i)));
+        }
+
+        __m128 ma = _mm_sub_ps(one, a);
+        for (k=0; k < 3; k++) {
+            __m128 f = _mm_sub_ps(_mm_mul_ps(half, _mm_add_ps(c1[k], c2[k])),
+                                  _mm_mul_ps(ma, _mm_loadu_ps(coeffs + (3+k)*n + i)));
+            _mm_storeu_si128((__m128i*) ic[k], _mm_cvttps_epi32(_mm_min_ps(full, _mm_max_ps(zero, f))));
+        }
+        _mm_storeu_si128((__m128i*) ia, _mm_cvttps_epi32(_mm_mul_ps(full, _mm_min_ps(one, _mm_max_ps(zero, a)))));
+
+        for (k=0; k < 4; k++) {
+            alpha[i+k] = (vxl_byte) ia[k];
+            object[i+k] = vil_rgb<vxl_byte>(ic[0][k], ic[1][k], ic[2][k]);
+        }
+    }
+#endif
+
+    // same arithmetic, one pixel at a time
+    for (; i < n; i++)
+        calibrated_pixel(comp, coeffs, n, i, 1.0f, -1.0f, alpha, object);
+}
+
+bool matting_calibration::matte(
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_2,
+        vil_image_view<vxl_byte>& alpha,
+        vil_image_view<vil_rgb<vxl_byte> >& object) const
+{
+    int ni = ni_, nj = nj_;
+    int j;
+
+    if (((int) comp_1.ni() != ni) || ((int) comp_1.nj() != nj) ||
+        ((int) comp_2.ni() != ni) || ((int) comp_2.nj() != nj))
+        return false;
+
+    alpha.set_size(ni, nj);
+    object.set_size(ni, nj);
+
+    // set_size() keeps a view of the right size as it is, so the outputs may be strided: their rows are then
+    // computed into a contiguous buffer and stored pixel by pixel
+    bool contiguous = (alpha.istep() == 1) && (object.istep() == 1);
+
+#pragma omp parallel if ((long) ni * nj > 65536)
+    {
+        vcl_vector<float> comp(6 * ni);
+        vcl_vector<vxl_byte> a_row(contiguous ? 0 : ni);
+        vcl_vector<vil_rgb<vxl_byte> > f_row(contiguous ? 0 : ni);
+        const vil_image_view<vil_rgb<vxl_byte> >* src[2] = { &comp_1, &comp_2 };
+
+#pragma omp for schedule(static)
+        for (j=0; j < nj; j++) {
+            for (int s=0; s < 2; s++) {
+                float* r = &comp[(3*s + 0) * ni];
+                float* g = &comp[(3*s + 1) * ni];
+                float* b = &comp[(3*s + 2) * ni];
+                for (int i=0; i < ni; i++) {
+                    const vil_rgb<vxl_byte>& v = (*src[s])(i,j);
+                    r[i] = v.r;
+                    g[i] = v.g;
+                    b[i] = v.b;
+                }
+            }
+
+            if (ni == 0)
+                continue;
+
+            vxl_byte* a = contiguous ? &alpha(0,j) : &a_row[0];
+            vil_rgb<vxl_byte>* f = contiguous ? &object(0,j) : &f_row[0];
+
+            calibrated_row(&comp[0], row(j), ni, a, f);
+            for (int e=equal_start_[j]; e < equal_start_[j+1]; e++)
+                calibrated_pixel(&comp[0], row(j), ni, equal_i_[e], equal_a0_[e], 1.0f, a, f);
+
+            if (!contiguous) {
+                for (int i=0; i < ni; i++) {
+                    alpha(i,j) = a_row[i];
+                    object(i,j) = f_row[i];
+                }
+            }
+        }
+    }
+
+    return true;
+}
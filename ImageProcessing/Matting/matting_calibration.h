@@ -0,0 +1,59 @@
+#ifndef MATTING_CALIBRATION_H
+#define MATTING_CALIBRATION_H
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+#include <vcl_vector.h>
+#include <vcl_cstddef.h>
+
+//
+//  Background calibration of a pair of fixed backgrounds for triangulation matting
+//
+//  Everything in the closed-form solution (see triangulation_solve()) that depends only on the
+//  backgrounds is computed once per pixel, so that a composite pair only costs
+//
+//      alpha = 1 + (C2 - C1).d
+//      F     = (C1 + C2)/2 - (1 - alpha) S
+//
+//  with dB = B1 - B2, d = dB/|dB|^2 and S = (B1 + B2)/2. Where the backgrounds are equal to B, the
+//  minimum-norm solution is instead alpha = a0 + (C1 + C2).d with a0 = |B|^2/(|B|^2 + 1) and
+//  d = -B/(2(|B|^2 + 1)).
+//
+//  d and S are stored in single precision as planar rows (24 bytes per pixel). The pixels with equal
+//  backgrounds are rare and kept, with their a0, in a sparse list per row, and re-solved after the rest of
+//  their row. The matte is solved 8 pixels per AVX2 instruction (4 with SSE2), with the rows spread over the
+//  OpenMP threads. As with MATTING_VECTORIZED, a truncated 8-bit result may differ by 1 from
+//  MATTING_CLOSED_FORM.
+//
+class matting_calibration {
+public:
+    // empty if the sizes of the backgrounds differ
+    matting_calibration(
+            const vil_image_view<vil_rgb<vxl_byte> >& back_1,
+            const vil_image_view<vil_rgb<vxl_byte> >& back_2);
+
+    int ni() const { return ni_; }
+    int nj() const { return nj_; }
+
+    // solves a composite pair shot over the backgrounds; fails if the sizes differ
+    bool matte(
+            const vil_image_view<vil_rgb<vxl_byte> >& comp_1,
+            const vil_image_view<vil_rgb<vxl_byte> >& comp_2,
+            vil_image_view<vxl_byte>& alpha,
+            vil_image_view<vil_rgb<vxl_byte> >& object) const;
+
+    // d r,g,b and S r,g,b of row j, ni floats apart
+    const float* row(int j) const { return &coeffs_[6 * (vcl_size_t) ni_ * j]; }
+
+private:
+    int ni_, nj_;
+    vcl_vector<float> coeffs_;
+
+    // the pixels of row j with equal backgrounds are entries equal_start_[j] to equal_start_[j+1] - 1 of
+    // equal_i_ (their i) and equal_a0_
+    vcl_vector<int> equal_start_;
+    vcl_vector<int> equal_i_;
+    vcl_vector<float> equal_a0_;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "matting_composite.h"
+#include <vcl_vector.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// round(x/255) for x in [0, 255*255]
+static inline int div255(int x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+//
+//  out = f + t*n/255 over n bytes, where t holds 255 - alpha replicated over the three channels. The
+//  channels are widened to 16 bits by unpacking with zero and narrowed back by packing: both work within
+//  128-bit lanes, so the bytes come back in order
+//
+static void blend_row(const vxl_byte* t, const vxl_byte* f, const vxl_byte* b, vxl_byte* out, int n)
+{
+    int k = 0;
+
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256(), round = _mm256_set1_epi16(128);
+
+    for (; k + 32 <= n; k += 32) {
+        __m256i tt = _mm256_loadu_si256((const __m256i*) (t + k));
+        __m256i bb = _mm256_loadu_si256((const __m256i*) (b + k));
+
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(tt, zero), _mm256_unpacklo_epi8(bb, zero)), round);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(tt, zero), _mm256_unpackhi_epi8(bb, zero)), round);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+        __m256i ff = _mm256_loadu_si256((const __m256i*) (f + k));
+        _mm256_storeu_si256((__m256i*) (out + k), _mm256_adds_epu8(ff, _mm256_packus_epi16(lo, hi)));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128(), round = _mm_set1_epi16(128);
+
+    for (; k + 16 <= n; k += 16) {
+        __m128i tt = _mm_loadu_si128((const __m128i*) (t + k));
+        __m128i bb = _mm_loadu_si128((const __m128i*) (b + k));
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(tt, zero), _mm_unpacklo_epi8(bb, zero)), round);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(tt, zero), _mm_unpackhi_epi8(bb, zero)), round);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        __m128i ff = _mm_loadu_si128((const __m128i*) (f + k));
+        _mm_storeu_si128((__m128i*) (out + k), _mm_adds_epu8(ff, _mm_packus_epi16(lo, hi)));
+    }
+#endif
+
+    for (; k < n; k++) {
+        int v = f[k] + div255(t[k] * b[k]);
+        out[k] = (vxl_byte) (v > 255 ? 255 : v);
+    }
+}
+
+bool composite_matte(
+        const vil_image_view<vxl_byte>& alpha,
+        const vil_image_view<vil_rgb<vxl_byte> >& object,
+        const vil_image_view<vil_rgb<vxl_byte> >* backs,
+        vil_image_view<vil_rgb<vxl_byte> >* outputs,
+        int nbacks)
+{
+    int ni = alpha.ni(), nj = alpha.nj();
+    int j, k;
+
+    if (((int) object.ni() != ni) || ((int) object.nj() != nj))
+        return false;
+    for (k=0; k < nbacks; k++)
+        if (((int) backs[k].ni() != ni) || ((int) backs[k].nj() != nj))
+            return false;
+
+    // the rows are read as byte streams when their pixels are contiguous
+    bool packed = (object.istep() == 1) && (sizeof(vil_rgb<vxl_byte>) == 3);
+    for (k=0; k < nbacks; k++) {
+        outputs[k].set_size(ni, nj);
+        packed = packed && (backs[k].istep() == 1) && (outputs[k].istep() == 1);
+    }
+
+#pragma omp parallel if ((long) ni * nj * nbacks > 65536)
+    {
+        vcl_vector<vxl_byte> t(3 * ni);
+
+#pragma omp for schedule(static)
+        for (j=0; j < nj; j++) {
+            if (ni == 0)
+                continue;
+
+            for (int i=0; i < ni; i++)
+                t[3*i] = t[3*i + 1] = t[3*i + 2] = 255 - alpha(i,j);
+
+            for (int m=0; m < nbacks; m++) {
+                if (packed) {
+                    blend_row(&t[0], (const vxl_byte*) &object(0,j), (const vxl_byte*) &backs[m](0,j),
+                              (vxl_byte*) &outputs[m](0,j), 3 * ni);
+                    continue;
+                }
+
+                for (int i=0; i < ni; i++) {
+                    vxl_byte f[3] = { object(i,j).r, object(i,j).g, object(i,j).b };
+                    vxl_byte b[3] = { backs[m](i,j).r, backs[m](i,j).g, backs[m](i,j).b };
+                    vxl_byte out[3];
+
+                    blend_row(&t[3*i], f, b, out, 3);
+                    outputs[m](i,j) = vil_rgb<vxl_byte>(out[0], out[1], out[2]);
+                }
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef MATTING_COMPOSITE_H
+#define MATTING_COMPOSITE_H
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+
+//
+//  Composites a matte over nbacks backgrounds in a single pass over the matte:
+//
+//      outputs[k] = object + (1 - alpha)*backs[k]
+//
+//  object is the premultiplied foreground computed by triangulation_matte(), and alpha is scaled to
+//  [0,255]. The blend is done in 8-bit fixed point, 32 channels per AVX2 instruction (16 with SSE2),
+//  with (1 - alpha)*B/255 rounded to nearest. Each row of the matte is read once for all the backgrounds.
+//
+//  The outputs are allocated if needed; an output may share the buffer of its background. Fails if the
+//  sizes differ.
+//
+bool composite_matte(
+        const vil_image_view<vxl_byte>& alpha,
+        const vil_image_view<vil_rgb<vxl_byte> >& object,
+        const vil_image_view<vil_rgb<vxl_byte> >* backs,
+        vil_image_view<vil_rgb<vxl_byte> >* outputs,
+        int nbacks);
+
+#endif
@@ -0,0 +1,339 @@
+#include "matting_solver.h"
+#include <vnl/vnl_matrix.h>
+#include <vnl/algo/vnl_svd.h>
+#include <vcl_vector.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void triangulation_solve_svd(
+        const vil_rgb<vxl_byte>& c1, const vil_rgb<vxl_byte>& c2,
+        const vil_rgb<vxl_byte>& b1, const vil_rgb<vxl_byte>& b2,
+        double& alpha, double* f)
+{
+    vnl_matrix<double> A(6,4, 0.0);
+    vnl_matrix<double> b(6,1);
+
+    A(0,0) = 1.0;
+    A(1,1) = 1.0;
+    A(2,2) = 1.0;
+    A(0,3) = -1*b1.r;
+    A(1,3) = -1*b1.g;
+    A(2,3) = -1*b1.b;
+
+    A(3,0) = 1.0;
+    A(4,1) = 1.0;
+    A(5,2) = 1.0;
+    A(3,3) = -1*b2.r;
+    A(4,3) = -1*b2.g;
+    A(5,3) = -1*b2.b;
+
+    b(0,0) = c1.r - b1.r;
+    b(1,0) = c1.g - b1.g;
+    b(2,0) = c1.b - b1.b;
+
+    b(3,0) = c2.r - b2.r;
+    b(4,0) = c2.g - b2.g;
+    b(5,0) = c2.b - b2.b;
+
+    vnl_matrix<double> y = vnl_svd<double>(A).pinverse(4);
+    vnl_matrix<double> x = y * b;
+
+    f[0] = x(0,0);
+    f[1] = x(1,0);
+    f[2] = x(2,0);
+    alpha = x(3,0);
+}
+
+// clamps a solution to the valid range and stores it
+static void store(double alpha, const double* f, vxl_byte& a, vil_rgb<vxl_byte>& object)
+{
+    double v[3];
+
+    for (int c=0; c < 3; c++) {
+        v[c] = f[c];
+        if (v[c] > 255)
+            v[c] = 255;
+        if (v[c] < 0)
+            v[c] = 0;
+    }
+
+    object.r = v[0];
+    object.g = v[1];
+    object.b = v[2];
+
+    if (alpha > 1)
+        alpha = 1;
+    if (alpha < 0)
+        alpha = 0;
+
+    a = alpha*255;
+}
+
+//
+//  Single-precision kernel of MATTING_VECTORIZED. comp holds the planar float rows of n pixels
+//  C1 r,g,b, C2 r,g,b and back the ones of B1 r,g,b, B2 r,g,b (in this order, n floats apart)
+//
+
+// one pixel, for the tail of a row; same arithmetic as the vector code
+static void solve_float(const float* comp, const float* back, int n, int i, vxl_byte& a, vil_rgb<vxl_byte>& object)
+{
+    float c[3], b[3], dc = 0, nb = 0, b2n = 0, cb = 0;
+    int k;
+
+    for (k=0; k < 3; k++) {
+        float c1 = comp[k*n + i], c2 = comp[(3+k)*n + i], b1 = back[k*n + i], b2 = back[(3+k)*n + i];
+        float db = b1 - b2;
+
+        c[k] = 0.5f * (c1 + c2);
+        b[k] = 0.5f * (b1 + b2);
+        nb += db * db;
+        dc += (c1 - c2) * db;
+        b2n += b[k] * b[k];
+        cb += c[k] * b[k];
+    }
+
+    float alpha = (nb > 0) ? 1.0f - dc / nb : (b2n - cb) / (b2n + 1.0f);
+    float f[3];
+    for (k=0; k < 3; k++) {
+        f[k] = c[k] - (1.0f - alpha) * b[k];
+        f[k] = (f[k] < 0) ? 0 : ((f[k] > 255) ? 255 : f[k]);
+    }
+    alpha = (alpha < 0) ? 0 : ((alpha > 1) ? 1 : alpha);
+
+    object.r = (vxl_byte) f[0];
+    object.g = (vxl_byte) f[1];
+    object.b = (vxl_byte) f[2];
+    a = (vxl_byte) (alpha * 255);
+}
+
+static void solve_row(const float* comp, const float* back, int n, vxl_byte* alpha, vil_rgb<vxl_byte>* object)
+{
+    int i = 0, k;
+
+#if defined(__AVX2__)
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f), full = _mm256_set1_ps(255.0f);
+    int ia[8], ir[8], ig[8], ib[8];
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 c[3], b[3];
+        __m256 nb = zero, dc = zero, b2n = zero, cb = zero;
+
+        for (k=0; k < 3; k++) {
+            __m256 c1 = _mm256_loadu_ps(comp + k*n + i), c2 = _mm256_loadu_ps(comp + (3+k)*n + i);
+            __m256 b1 = _mm256_loadu_ps(back + k*n + i), b2 = _mm256_loadu_ps(back + (3+k)*n + i);
+            __m256 db = _mm256_sub_ps(b1, b2);
+
+            c[k] = _mm256_mul_ps(half, _mm256_add_ps(c1, c2));
+            b[k] = _mm256_mul_ps(half, _mm256_add_ps(b1, b2));
+            nb = _mm256_add_ps(nb, _mm256_mul_ps(db, db));
+            dc = _mm256_add_ps(dc, _mm256_mul_ps(_mm256_sub_ps(c1, c2), db));
+            b2n = _mm256_add_ps(b2n, _mm256_mul_ps(b[k], b[k]));
+            cb = _mm256_add_ps(cb, _mm256_mul_ps(c[k], b[k]));
+        }
+
+// lanes with equal backgrounds divide by zero in the first form and are replaced by the second one
+        __m256 a = _mm256_blendv_ps(
+                    _mm256_div_ps(_mm256_sub_ps(b2n, cb), _mm256_add_ps(b2n, one)),
+                    _mm256_sub_ps(one, _mm256_div_ps(dc, nb)),
+                    _mm256_cmp_ps(nb, zero, _CMP_GT_OQ));
+        __m256 ma = _mm256_sub_ps(one, a);
+
+        __m256i fr = _mm256_cvttps_epi32(_mm256_min_ps(full, _mm256_max_ps(zero, _mm256_sub_ps(c[0], _mm256_mul_ps(ma, b[0])))));
+        __m256i fg = _mm256_cvttps_epi32(_mm256_min_ps(full, _mm256_max_ps(zero, _mm256_sub_ps(c[1], _mm256_mul_ps(ma, b[1])))));
+        __m256i fb = _mm256_cvttps_epi32(_mm256_min_ps(full, _mm256_max_ps(zero, _mm256_sub_ps(c[2], _mm256_mul_ps(ma, b[2])))));
+        __m256i ai = _mm256_cvttps_epi32(_mm256_mul_ps(full, _mm256_min_ps(one, _mm256_max_ps(zero, a))));
+
+        _mm256_storeu_si256((__m256i*) ia, ai);
+        _mm256_storeu_si256((__m256i*) ir, fr);
+        _mm256_storeu_si256((__m256i*) ig, fg);
+        _mm256_storeu_si256((__m256i*) ib, fb);
+        for (k=0; k < 8; k++) {
+            alpha[i+k] = (vxl_byte) ia[k];
+            object[i+k].r = (vxl_byte) ir[k];
+            object[i+k].g = (vxl_byte) ig[k];
+            object[i+k].b = (vxl_byte) ib[k];
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f), full = _mm_set1_ps(255.0f);
+    int ia[4], ir[4], ig[4], ib[4];
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 c[3], b[3];
+        __m128 nb = zero, dc = zero, b2n = zero, cb = zero;
+
+        for (k=0; k < 3; k++) {
+            __m128 c1 = _mm_loadu_ps(comp + k*n + i), c2 = _mm_loadu_ps(comp + (3+k)*n + i);
+            __m128 b1 = _mm_loadu_ps(back + k*n + i), b2 = _mm_loadu_ps(back + (3+k)*n + i);
+            __m128 db = _mm_sub_ps(b1, b2);
+
+            c[k] = _mm_mul_ps(half, _mm_add_ps(c1, c2));
+            b[k] = _mm_mul_ps(half, _mm_add_ps(b1, b2));
+            nb = _mm_add_ps(nb, _mm_mul_ps(db, db));
+            dc = _mm_add_ps(dc, _mm_mul_ps(_mm_sub_ps(c1, c2), db));
+            b2n = _mm_add_ps(b2n, _mm_mul_ps(b[k], b[k]));
+            cb = _mm_add_ps(cb, _mm_mul_ps(c[k], b[k]));
+        }
+
+// SSE2 has no blend: select with and/andnot
+        __m128 m = _mm_cmpgt_ps(nb, zero);
+        __m128 a = _mm_or_ps(
+                    _mm_and_ps(m, _mm_sub_ps(one, _mm_div_ps(dc, nb))),
+                    _mm_andnot_ps(m, _mm_div_ps(_mm_sub_ps(b2n, cb), _mm_add_ps(b2n, one))));
+        __m128 ma = _mm_sub_ps(one, a);
+
+        __m128i fr = _mm_cvttps_epi32(_mm_min_ps(full, _mm_max_ps(zero, _mm_sub_ps(c[0], _mm_mul_ps(ma, b[0])))));
+        __m128i fg = _mm_cvttps_epi32(_mm_min_ps(full, _mm_max_ps(zero, _mm_sub_ps(c[1], _mm_mul_ps(ma, b[1])))));
+        __m128i fb = _mm_cvttps_epi32(_mm_min_ps(full, _mm_max_ps(zero, _mm_sub_ps(c[2], _mm_mul_ps(ma, b[2])))));
+        __m128i ai = _mm_cvttps_epi32(_mm_mul_ps(full, _mm_min_ps(one, _mm_max_ps(zero, a))));
+
+        _mm_storeu_si128((__m128i*) ia, ai);
+        _mm_storeu_si128((__m128i*) ir, fr);
+        _mm_storeu_si128((__m128i*) ig, fg);
+        _mm_storeu_si128((__m128i*) ib, fb);
+        for (k=0; k < 4; k++) {
+            alpha[i+k] = (vxl_byte) ia[k];
+            object[i+k].r = (vxl_byte) ir[k];
+            object[i+k].g = (vxl_byte) ig[k];
+            object[i+k].b = (vxl_byte) ib[k];
+        }
+    }
+#endif
+
+    for (; i < n; i++)
+        solve_float(comp, back, n, i, alpha[i], object[i]);
+}
+
+// converts the ni pixels of row j of two images starting at column i0 to 6 planar float rows
+static void planar_row(
+        const vil_image_view<vil_rgb<vxl_byte> >& im_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& im_2,
+        int i0, int ni, int j, float* out)
+{
+    const vil_image_view<vil_rgb<vxl_byte> >* src[2] = { &im_1, &im_2 };
+
+    for (int s=0; s < 2; s++) {
+        float* r = out + (3*s + 0) * ni;
+        float* g = out + (3*s + 1) * ni;
+        float* b = out + (3*s + 2) * ni;
+        for (int i=0; i < ni; i++) {
+            const vil_rgb<vxl_byte>& v = (*src[s])(i0 + i,j);
+            r[i] = v.r;
+            g[i] = v.g;
+            b[i] = v.b;
+        }
+    }
+}
+
+//
+//  Row-parallel driver of the vectorized kernel over the region [i0,i0+ni)x[j0,j0+nj). set_size() keeps a view
+//  of the right size as it is, so alpha and object may be strided (eg. one plane of an interleaved image): their
+//  rows are then solved into a contiguous buffer and stored pixel by pixel
+//
+static void triangulation_matte_rows(
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_2,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_2,
+        int i0, int j0, int ni, int nj,
+        vil_image_view<vxl_byte>& alpha,
+        vil_image_view<vil_rgb<vxl_byte> >& object)
+{
+    int j;
+    bool contiguous = (alpha.istep() == 1) && (object.istep() == 1);
+
+#pragma omp parallel if ((long) ni * nj > 65536)
+    {
+        vcl_vector<float> in(12 * ni);
+        vcl_vector<vxl_byte> a_row(contiguous ? 0 : ni);
+        vcl_vector<vil_rgb<vxl_byte> > f_row(contiguous ? 0 : ni);
+
+#pragma omp for schedule(static)
+        for (j=j0; j < j0 + nj; j++) {
+            planar_row(comp_1, comp_2, i0, ni, j, &in[0]);
+            planar_row(back_1, back_2, i0, ni, j, &in[6 * ni]);
+
+            if (contiguous) {
+                solve_row(&in[0], &in[6 * ni], ni, &alpha(i0,j), &object(i0,j));
+                continue;
+            }
+
+            solve_row(&in[0], &in[6 * ni], ni, &a_row[0], &f_row[0]);
+            for (int i=0; i < ni; i++) {
+                alpha(i0 + i,j) = a_row[i];
+                object(i0 + i,j) = f_row[i];
+            }
+        }
+    }
+}
+
+bool triangulation_matte(
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_2,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_2,
+        vil_image_view<vxl_byte>& alpha,
+        vil_image_view<vil_rgb<vxl_byte> >& object,
+        matting_solver solver)
+{
+    int ni = comp_1.ni(), nj = comp_1.nj();
+
+    if (((int) comp_2.ni() != ni) || ((int) comp_2.nj() != nj) ||
+        ((int) back_1.ni() != ni) || ((int) back_1.nj() != nj) ||
+        ((int) back_2.ni() != ni) || ((int) back_2.nj() != nj))
+        return false;
+
+    alpha.set_size(ni, nj);
+    object.set_size(ni, nj);
+
+    if (solver == MATTING_VECTORIZED) {
+        triangulation_matte_rows(comp_1, comp_2, back_1, back_2, 0, 0, ni, nj, alpha, object);
+        return true;
+    }
+
+    for (int j=0; j < nj; j++) {
+        for (int i=0; i < ni; i++) {
+            double a, f[3];
+
+            if (solver == MATTING_SVD)
+                triangulation_solve_svd(comp_1(i,j), comp_2(i,j), back_1(i,j), back_2(i,j), a, f);
+            else
+                triangulation_solve(comp_1(i,j), comp_2(i,j), back_1(i,j), back_2(i,j), a, f);
+
+            store(a, f, alpha(i,j), object(i,j));
+        }
+    }
+
+    return true;
+}
+
+bool triangulation_matte_region(
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_2,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_2,
+        int i0, int j0, int ni, int nj,
+        vil_image_view<vxl_byte>& alpha,
+        vil_image_view<vil_rgb<vxl_byte> >& object)
+{
+    int w = comp_1.ni(), h = comp_1.nj();
+
+    if (((int) comp_2.ni() != w) || ((int) comp_2.nj() != h) ||
+        ((int) back_1.ni() != w) || ((int) back_1.nj() != h) ||
+        ((int) back_2.ni() != w) || ((int) back_2.nj() != h) ||
+        ((int) alpha.ni() != w) || ((int) alpha.nj() != h) || (alpha.istep() != 1) ||
+        ((int) object.ni() != w) || ((int) object.nj() != h) || (object.istep() != 1))
+        return false;
+    if ((i0 < 0) || (j0 < 0) || (ni < 0) || (nj < 0) || (i0 + ni > w) || (j0 + nj > h))
+        return false;
+
+    if ((ni > 0) && (nj > 0))
+        triangulation_matte_rows(comp_1, comp_2, back_1, back_2, i0, j0, ni, nj, alpha, object);
+
+    return true;
+}
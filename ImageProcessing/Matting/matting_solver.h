@@ -0,0 +1,108 @@
+#ifndef MATTING_SOLVER_H
+#define MATTING_SOLVER_H
+
+#include <vil/vil_image_view.h>
+#include <vil/vil_rgb.h>
+
+//
+//  Per-pixel solvers of the triangulation matting equations
+//
+//  For every pixel the unknowns are the premultiplied foreground F = alpha*Fo and alpha, and the two
+//  composites C1, C2 over the backgrounds B1, B2 give six equations
+//
+//      F - alpha*B1 = C1 - B1
+//      F - alpha*B2 = C2 - B2
+//
+
+enum matting_solver {
+    MATTING_CLOSED_FORM,        // analytic least-squares solution, no allocation
+    MATTING_SVD,                // pseudo-inverse of the 6x4 system through vnl_svd (reference)
+    MATTING_VECTORIZED          // closed form in single precision on planar rows, row-parallel and AVX2
+};
+
+//
+//  Closed-form least-squares solution. For a fixed alpha the best F is the mean of the two equations, and
+//  the residual left is |(C1 - C2) - (1 - alpha)(B1 - B2)|^2, so with dB = B1 - B2:
+//
+//      alpha = 1 - (C1 - C2).dB / |dB|^2
+//      F     = (C1 + C2)/2 - (1 - alpha)(B1 + B2)/2
+//
+//  When the backgrounds are equal every alpha fits equally well and, as the pseudo-inverse does, the
+//  minimum-norm solution is returned: with B = B1 = B2 and C = (C1 + C2)/2,
+//
+//      alpha = (|B|^2 - C.B) / (|B|^2 + 1)
+//
+//  Colours are in [0,255]; the results are not clamped.
+//
+inline void triangulation_solve(
+        const vil_rgb<vxl_byte>& c1, const vil_rgb<vxl_byte>& c2,
+        const vil_rgb<vxl_byte>& b1, const vil_rgb<vxl_byte>& b2,
+        double& alpha, double* f)
+{
+    double dbr = (int) b1.r - (int) b2.r;
+    double dbg = (int) b1.g - (int) b2.g;
+    double dbb = (int) b1.b - (int) b2.b;
+    double nb = dbr*dbr + dbg*dbg + dbb*dbb;
+
+    double cr = 0.5 * ((int) c1.r + (int) c2.r);
+    double cg = 0.5 * ((int) c1.g + (int) c2.g);
+    double cb = 0.5 * ((int) c1.b + (int) c2.b);
+    double br = 0.5 * ((int) b1.r + (int) b2.r);
+    double bg = 0.5 * ((int) b1.g + (int) b2.g);
+    double bb = 0.5 * ((int) b1.b + (int) b2.b);
+
+    if (nb > 0) {
+        double dc = ((int) c1.r - (int) c2.r) * dbr +
+                    ((int) c1.g - (int) c2.g) * dbg +
+                    ((int) c1.b - (int) c2.b) * dbb;
+        alpha = 1.0 - dc / nb;
+    } else {
+        double b2n = br*br + bg*bg + bb*bb;
+        alpha = (b2n - (cr*br + cg*bg + cb*bb)) / (b2n + 1.0);
+    }
+
+    f[0] = cr - (1.0 - alpha) * br;
+    f[1] = cg - (1.0 - alpha) * bg;
+    f[2] = cb - (1.0 - alpha) * bb;
+}
+
+//
+//  Reference solution of the same system through the SVD pseudo-inverse (slow: allocates per call)
+//
+void triangulation_solve_svd(
+        const vil_rgb<vxl_byte>& c1, const vil_rgb<vxl_byte>& c2,
+        const vil_rgb<vxl_byte>& b1, const vil_rgb<vxl_byte>& b2,
+        double& alpha, double* f);
+
+//
+//  Solves every pixel of the four images (which must have the same size) and stores the clamped
+//  premultiplied foreground in object and alpha*255 in alpha
+//
+//  MATTING_VECTORIZED converts each row of the inputs to planar float streams and solves 8 pixels per
+//  AVX2 instruction (4 with SSE2, scalar otherwise), with the rows spread over the OpenMP threads. Single
+//  precision may move a truncated 8-bit result by 1 compared to MATTING_CLOSED_FORM.
+//
+bool triangulation_matte(
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_2,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_2,
+        vil_image_view<vxl_byte>& alpha,
+        vil_image_view<vil_rgb<vxl_byte> >& object,
+        matting_solver solver = MATTING_CLOSED_FORM);
+
+//
+//  MATTING_VECTORIZED solution of the region [i0,i0+ni)x[j0,j0+nj) only. alpha and object must already have
+//  the size of the inputs (and contiguous rows); their pixels outside the region are left unchanged. Fails
+//  if the sizes differ or the region is not inside the images
+//
+bool triangulation_matte_region(
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& comp_2,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_1,
+        const vil_image_view<vil_rgb<vxl_byte> >& back_2,
+        int i0, int j0, int ni, int nj,
+        vil_image_view<vxl_byte>& alpha,
+        vil_image_view<vil_rgb<vxl_byte> >& object);
+
+#endif
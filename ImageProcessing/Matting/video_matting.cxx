@@ -0,0 +1,445 @@
+//
+//  Streaming triangulation matting of video
+//
+//  usage: video_matting [options] comp_1 comp_2 back_1 back_2 new_back output
+//      -f first    number of the first frame (default: 0)
+//      -n count    number of frames (default: up to the first missing one)
+//      -q depth    capacity of the queues between the stages (default: 2)
+//      -t file     write the timing report to file instead of stdout
+//
+//  A take is shot twice, over the two fixed backgrounds back_1 and back_2. comp_1, comp_2 and output are
+//  printf patterns of the frame number, e.g. "take_1/%05d.png"; new_back is either a single image or, if it
+//  contains a '%', the pattern of a background sequence. Frame k of output is frame k of the take, matted
+//  from frames k of comp_1 and comp_2 and composited over new_back.
+//
+//  The frames flow through four concurrent stages connected by bounded queues: decode, matte (with the
+//  background calibration computed once for the whole take, see matting_calibration), composite and encode.
+//  Frame buffers are taken from a fixed pool and recycled by the encoder, so memory does not depend on the
+//  length of the clip.
+//
+
+#include "matting_calibration.h"
+#include "matting_composite.h"
+#include <vil/vil_load.h>
+#include <vil/vil_save.h>
+#include <vcl_iostream.h>
+#include <vcl_fstream.h>
+#include <vcl_string.h>
+#include <vcl_vector.h>
+#include <vcl_deque.h>
+#include <vcl_cstdio.h>
+#include <vcl_cstdlib.h>
+#include <vcl_cstring.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+typedef vil_image_view<vil_rgb<vxl_byte> > rgb_image;
+
+//
+//  The buffers of one frame. The composite is written over comp_1, which the matte no longer needs
+//
+struct video_frame {
+    int index;
+    rgb_image comp_1, comp_2, new_back, object;
+    vil_image_view<vxl_byte> alpha;
+};
+
+//
+//  Blocking queue of at most capacity items. pop() fails once the queue is closed and empty
+//
+template <class T>
+class bounded_queue {
+public:
+    bounded_queue(int capacity) : capacity_(capacity), closed_(false) {}
+
+    void push(const T& item)
+    {
+        std::unique_lock<std::mutex> guard(lock_);
+        while ((int) items_.size() >= capacity_)
+            not_full_.wait(guard);
+        items_.push_back(item);
+        not_empty_.notify_one();
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> guard(lock_);
+        while (items_.empty() && !closed_)
+            not_empty_.wait(guard);
+        if (items_.empty())
+            return false;
+        item = items_.front();
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    int capacity_;
+    bool closed_;
+    vcl_deque<T> items_;
+    std::mutex lock_;
+    std::condition_variable not_empty_, not_full_;
+};
+
+struct video_state {
+    vcl_string comp_1, comp_2, new_back, output;
+    int first, count;
+
+    rgb_image back_image;       // the new background, when it is a single image
+    matting_calibration* calibration;
+
+    bounded_queue<video_frame*> *pool, *decoded, *matted, *composited;
+
+    std::mutex lock;
+    bool failed;                // a later stage failed: the frames still in flight are dropped
+    vcl_string error;
+    vcl_string decode_error;    // the clip ends at the frame that cannot be read
+    int frames;
+
+    // busy time of every stage, in seconds
+    double t_decode, t_matte, t_composite, t_encode;
+};
+
+static double seconds_since(const std::chrono::steady_clock::time_point& t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// true if pattern holds exactly one conversion, of an int ("%d", "%05d", "%x", ...), besides literal "%%"
+static bool frame_pattern(const vcl_string& pattern)
+{
+    int conversions = 0;
+    vcl_string::size_type k = 0, n = pattern.size();
+
+    while (k < n) {
+        if (pattern[k++] != '%')
+            continue;
+        if ((k < n) && (pattern[k] == '%')) {
+            k++;
+            continue;
+        }
+        while ((k < n) && vcl_strchr("-+ #0", pattern[k]))
+            k++;
+        while ((k < n) && (pattern[k] >= '0') && (pattern[k] <= '9'))
+            k++;
+        if ((k < n) && (pattern[k] == '.')) {
+            k++;
+            while ((k < n) && (pattern[k] >= '0') && (pattern[k] <= '9'))
+                k++;
+        }
+        if ((k == n) || !vcl_strchr("diouxX", pattern[k]))
+            return false;
+        k++;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// the name of frame index of a pattern accepted by frame_pattern(); false if it does not fit
+static bool frame_name(const vcl_string& pattern, int index, vcl_string& name)
+{
+    char buf[4096];
+    int n = vcl_snprintf(buf, sizeof(buf), pattern.c_str(), index);
+
+    if ((n < 0) || (n >= (int) sizeof(buf)))
+        return false;
+    name = buf;
+    return true;
+}
+
+static void fail(video_state& state, const vcl_string& error)
+{
+    std::lock_guard<std::mutex> guard(state.lock);
+    if (!state.failed)
+        state.error = error;
+    state.failed = true;
+}
+
+static bool failed(video_state& state)
+{
+    std::lock_guard<std::mutex> guard(state.lock);
+    return state.failed;
+}
+
+//
+//  Loads a color or gray-level image into im, reusing its buffer when the size does not change. If ni > 0,
+//  the image must be ni x nj
+//
+static bool load_frame(const vcl_string& fname, int ni, int nj, rgb_image& im)
+{
+    vil_image_view<vxl_byte> in = vil_load(fname.c_str());
+
+    if (!in || ((in.nplanes() != 1) && (in.nplanes() < 3)))
+        return false;
+    if ((ni > 0) && (((int) in.ni() != ni) || ((int) in.nj() != nj)))
+        return false;
+
+    im.set_size(in.ni(), in.nj());
+    for (int j=0; j < (int) in.nj(); j++) {
+        for (int i=0; i < (int) in.ni(); i++) {
+            if (in.nplanes() == 1)
+                im(i,j) = vil_rgb<vxl_byte>(in(i,j), in(i,j), in(i,j));
+            else
+                im(i,j) = vil_rgb<vxl_byte>(in(i,j,0), in(i,j,1), in(i,j,2));
+        }
+    }
+
+    return true;
+}
+
+static bool save_frame(const vcl_string& fname, const rgb_image& im)
+{
+    vil_image_view<vxl_byte> out(im.ni(), im.nj(), 3);
+
+    for (int j=0; j < (int) im.nj(); j++) {
+        for (int i=0; i < (int) im.ni(); i++) {
+            out(i,j,0) = im(i,j).r;
+            out(i,j,1) = im(i,j).g;
+            out(i,j,2) = im(i,j).b;
+        }
+    }
+
+    return vil_save(out, fname.c_str());
+}
+
+//
+//  The stages. Each one passes its frames on in order and closes its output queue when its input is
+//  exhausted. When a frame of the take cannot be read, the frames before it are still written; after a failure
+//  of a later stage the frames in flight are only returned to the pool, so that no stage blocks
+//
+
+static void decode_stage(video_state* state)
+{
+    int ni = state->calibration->ni(), nj = state->calibration->nj();
+
+    for (int k=state->first; (state->count < 0) || (k < state->first + state->count); k++) {
+        video_frame* frame;
+        std::chrono::steady_clock::time_point t0;
+
+        state->pool->pop(frame);
+        if (failed(*state)) {
+            state->pool->push(frame);
+            break;
+        }
+
+        t0 = std::chrono::steady_clock::now();
+        vcl_string name, name_2, name_back;
+        if (!frame_name(state->comp_1, k, name) || !frame_name(state->comp_2, k, name_2) ||
+            (!state->back_image && !frame_name(state->new_back, k, name_back))) {
+            state->decode_error = "the name of an input frame is too long";
+            state->pool->push(frame);
+            break;
+        }
+        bool ok = load_frame(name, ni, nj, frame->comp_1);
+
+        // without a frame count the clip ends at its first missing frame
+        if (!ok && (state->count < 0) && (k > state->first)) {
+            vcl_FILE* f = vcl_fopen(name.c_str(), "rb");
+            if (!f) {
+                state->pool->push(frame);
+                break;
+            }
+            vcl_fclose(f);
+        }
+
+        ok = ok && load_frame(name_2, ni, nj, frame->comp_2);
+        if (ok && state->back_image)
+            frame->new_back = state->back_image;
+        else if (ok)
+            ok = load_frame(name_back, ni, nj, frame->new_back);
+        state->t_decode += seconds_since(t0);
+
+        if (!ok) {
+            state->decode_error = "cannot read frame " + name + " or its companions, or size mismatch";
+            state->pool->push(frame);
+            break;
+        }
+
+        frame->index = k;
+        state->decoded->push(frame);
+    }
+
+    state->decoded->close();
+}
+
+static void matte_stage(video_state* state)
+{
+    video_frame* frame;
+
+    while (state->decoded->pop(frame)) {
+        if (failed(*state)) {
+            state->pool->push(frame);
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        state->calibration->matte(frame->comp_1, frame->comp_2, frame->alpha, frame->object);
+        state->t_matte += seconds_since(t0);
+
+        state->matted->push(frame);
+    }
+
+    state->matted->close();
+}
+
+static void composite_stage(video_state* state)
+{
+    video_frame* frame;
+
+    while (state->matted->pop(frame)) {
+        if (failed(*state)) {
+            state->pool->push(frame);
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        composite_matte(frame->alpha, frame->object, &frame->new_back, &frame->comp_1, 1);
+        state->t_composite += seconds_since(t0);
+
+        state->composited->push(frame);
+    }
+
+    state->composited->close();
+}
+
+static void encode_stage(video_state* state)
+{
+    video_frame* frame;
+
+    while (state->composited->pop(frame)) {
+        if (!failed(*state)) {
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            vcl_string name;
+
+            if (!frame_name(state->output, frame->index, name))
+                fail(*state, "the name of an output frame is too long");
+            else if (save_frame(name, frame->comp_1))
+                state->frames++;
+            else
+                fail(*state, "cannot write " + name);
+            state->t_encode += seconds_since(t0);
+        }
+
+        state->pool->push(frame);
+    }
+}
+
+static int usage()
+{
+    vcl_cerr << "usage: video_matting [-f first] [-n count] [-q depth] [-t timing_file]\n"
+             << "                     comp_1 comp_2 back_1 back_2 new_back output\n";
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    video_state state;
+    int depth = 2;
+    const char* timing_fname = 0;
+    int a, n;
+
+    state.first = 0;
+    state.count = -1;
+
+    for (a=1; (a < argc - 1) && (argv[a][0] == '-'); a += 2) {
+        if (!vcl_strcmp(argv[a], "-f"))
+            state.first = vcl_atoi(argv[a+1]);
+        else if (!vcl_strcmp(argv[a], "-n"))
+            state.count = vcl_atoi(argv[a+1]);
+        else if (!vcl_strcmp(argv[a], "-q"))
+            depth = vcl_atoi(argv[a+1]);
+        else if (!vcl_strcmp(argv[a], "-t"))
+            timing_fname = argv[a+1];
+        else
+            return usage();
+    }
+    if ((a != argc - 6) || (depth < 1))
+        return usage();
+
+    state.comp_1 = argv[a];
+    state.comp_2 = argv[a+1];
+    state.new_back = argv[a+4];
+    state.output = argv[a+5];
+
+    // the patterns are handed to printf, so only a single int conversion is accepted
+    if (!frame_pattern(state.comp_1) || !frame_pattern(state.comp_2) || !frame_pattern(state.output) ||
+        ((state.new_back.find('%') != vcl_string::npos) && !frame_pattern(state.new_back))) {
+        vcl_cerr << "video_matting: comp_1, comp_2, output and a new_back sequence must hold exactly one int "
+                 << "conversion, e.g. %05d\n";
+        return 1;
+    }
+
+    // the per-take precomputation, shared by all the frames
+    rgb_image back_1, back_2;
+    if (!load_frame(argv[a+2], 0, 0, back_1) ||
+        !load_frame(argv[a+3], back_1.ni(), back_1.nj(), back_2)) {
+        vcl_cerr << "video_matting: cannot read the backgrounds, or size mismatch\n";
+        return 1;
+    }
+    if ((state.new_back.find('%') == vcl_string::npos) &&
+        !load_frame(state.new_back, back_1.ni(), back_1.nj(), state.back_image)) {
+        vcl_cerr << "video_matting: cannot read " << state.new_back << ", or size mismatch\n";
+        return 1;
+    }
+
+    state.calibration = new matting_calibration(back_1, back_2);
+    back_1 = back_2 = rgb_image();
+
+    // every stage holds at most one frame and every queue depth of them
+    int nframes = 3*depth + 4;
+    vcl_vector<video_frame> frames(nframes);
+    state.pool = new bounded_queue<video_frame*>(nframes);
+    state.decoded = new bounded_queue<video_frame*>(depth);
+    state.matted = new bounded_queue<video_frame*>(depth);
+    state.composited = new bounded_queue<video_frame*>(depth);
+    for (n=0; n < nframes; n++)
+        state.pool->push(&frames[n]);
+
+    state.failed = false;
+    state.frames = 0;
+    state.t_decode = state.t_matte = state.t_composite = state.t_encode = 0;
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    std::thread decode(decode_stage, &state);
+    std::thread matte(matte_stage, &state);
+    std::thread composite(composite_stage, &state);
+    std::thread encode(encode_stage, &state);
+    decode.join();
+    matte.join();
+    composite.join();
+    encode.join();
+    double total = seconds_since(t0);
+
+    // the stage with the largest busy time bounds the throughput
+    vcl_ofstream file;
+    if (timing_fname)
+        file.open(timing_fname);
+    vcl_ostream& out = timing_fname ? (vcl_ostream&) file : vcl_cout;
+
+    out << "# frames total fps decode matte composite encode\n";
+    out << state.frames << " " << total << " " << (total > 0 ? state.frames / total : 0) << " "
+        << state.t_decode << " " << state.t_matte << " " << state.t_composite << " " << state.t_encode << "\n";
+
+    if (state.failed)
+        vcl_cerr << "video_matting: " << state.error << "\n";
+    else if (!state.decode_error.empty())
+        vcl_cerr << "video_matting: " << state.decode_error << "\n";
+
+    delete state.pool;
+    delete state.decoded;
+    delete state.matted;
+    delete state.composited;
+    delete state.calibration;
+
+    return (state.failed || !state.decode_error.empty()) ? 1 : 0;
+}
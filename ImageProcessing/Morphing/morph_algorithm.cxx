@@ -1,4 +1,5 @@
 #include "morphing.h"
+#include "prepared_lines.h"
 
 // 
 // Top-level morphing routine
@@ -110,6 +111,50 @@ bool morphing::morph_iteration(int iter)
 	return true;
 }
 
+//
+// Resamples row i of destination from source, at the points the prepared lines warp the row to
+//
+// si and sj are scratch buffers of destination.nj() doubles. Rows are independent, so that both the rows of one
+// warp and the two warps of a morph can be computed in parallel.
+//
+static void warp_row(
+		const vil_image_view<vil_rgb<vxl_byte> >& 	source,
+								const prepared_lines&  lines,
+		double a, double b, int i,
+		double* si, double* sj,
+			   vil_image_view<vil_rgb<vxl_byte> >& 	destination)
+{
+	int h = destination.ni(), w = destination.nj();
+	int j;
+	double x, y;
+
+// the source point of each pixel X of the row is the weighted average of the pixel's warp by every line (P,Q)
+	lines.warp_row(i, 0, w, a, b, si, sj);
+
+	for (j=0; j < w; j++) {
+		y = si[j];
+		x = sj[j];
+
+		if (y > h-1)
+			y = h-1;
+		else if (y < 0)
+			y = 0;
+		else
+			y = floor(y+0.5);
+
+		if (x > w-1)
+			x = w-1;
+		else if (x < 0)
+			x = 0;
+		else
+			x = floor(x+0.5);
+
+		destination(i,j).r = source((int)y, (int)x).r;
+		destination(i,j).g = source((int)y, (int)x).g;
+		destination(i,j).b = source((int)y, (int)x).b;
+	}
+}
+
 //
 // Top-level implementation of the Beier-Neely morphing algorithm
 //
@@ -137,8 +182,28 @@ void morphing::compute_morph()
 	linepairs swapLP = I0I1_linepairs_.swap();
 	linepairs I1W1_linepairs_ = swapLP.interpolate(t_);
 
-	field_warp(I0_, I1W1_linepairs_, a_, b_, p_, warped_I0_);
-	field_warp(I1_, I0W0_linepairs_, a_, b_, p_, warped_I1_);
+// steps 1 and 2: field warp I0_ and I1_. This is field_warp() for both images at once: the rows of the two warps
+// are interleaved in one parallel loop, so that they run concurrently and share all the threads
+	int h = warped_I0_.ni(), w = warped_I0_.nj();
+	int k;
+	vnl_matrix<double> P,Q,Pprime,Qprime;
+
+	I1W1_linepairs_.get(P,Q,Pprime,Qprime);
+	prepared_lines lines0(P, Q, Pprime, Qprime, p_);
+	I0W0_linepairs_.get(P,Q,Pprime,Qprime);
+	prepared_lines lines1(P, Q, Pprime, Qprime, p_);
+
+#pragma omp parallel if ((long) h * w * (lines0.size() + lines1.size()) > 65536)
+	{
+		vcl_vector<double> si(w), sj(w);
+
+#pragma omp for schedule(static)
+		for (k=0; k < 2*h; k++)
+			if (k % 2 == 0)
+				warp_row(I0_, lines0, a_, b_, k/2, &si[0], &sj[0], warped_I0_);
+			else
+				warp_row(I1_, lines1, a_, b_, k/2, &si[0], &sj[0], warped_I1_);
+	}
 
 // step 3: linearly blend the morphed images
 	for (int i=0; i < I0_.ni(); i++) {
@@ -172,68 +237,23 @@ void morphing::field_warp(
 			   vil_image_view<vil_rgb<vxl_byte> >& 	destination)
 {
 	int h = destination.ni(), w = destination.nj();
-	double weightsum, weight, u, v, dist, x, y;
+	int i;
 
 	vnl_matrix<double> P,Q,Pprime,Qprime;
 
 	lps.get(P,Q,Pprime,Qprime);
 
-	vnl_vector_fixed<double,2> DSUM, Xprime, D;
-	vnl_vector_fixed<double,2> XP, XQ, QP, perpQP, QprimePprime, perpQprimePprime;
-
-// for each pixel X
-	for (int i=0; i < h; i++) {
-		for (int j=0; j < w; j++) {
-			DSUM = vnl_vector_fixed<double,2>(0.0,0.0);
-			weightsum = 0.0;
-// for each line (P,Q)
-			for (int l=0; l < P.cols(); l++) {
-				XP = vnl_vector_fixed<double,2>(i-P(0,l), j-P(1,l));
-				XQ = vnl_vector_fixed<double,2>(i-Q(0,l), j-Q(1,l));
-				QP = vnl_vector_fixed<double,2>(Q(0,l)-P(0,l), Q(1,l)-P(1,l));
-				perpQP = vnl_vector_fixed<double,2>(QP(1), -QP(0));
-				QprimePprime = vnl_vector_fixed<double,2>(Qprime(0,l)-Pprime(0,l), Qprime(1,l)-Pprime(1,l));
-				perpQprimePprime = vnl_vector_fixed<double,2>(QprimePprime(1), -QprimePprime(0));
-
-				u = dot_product(XP,	   QP) / pow(QP.magnitude(), 2);
-				v = dot_product(XP,perpQP) /     QP.magnitude();
-
-				Xprime(0) = Pprime(0,l) + u * QprimePprime(0) + v * perpQprimePprime(0) / QprimePprime.magnitude();
-				Xprime(1) = Pprime(1,l) + u * QprimePprime(1) + v * perpQprimePprime(1) / QprimePprime.magnitude();
-
-				D(0) = Xprime(0) - i;
-				D(1) = Xprime(1) - j;
-
-				if (u < 0.0)
-					dist = XP.magnitude();
-				else if (u > 1.0)
-					dist = XQ.magnitude();
-				else
-					dist = abs(v);
-
-				weight = pow(pow(QP.magnitude(), p) / (a + dist), b);
-
-				DSUM(0) += D(0) * weight;
-				DSUM(1) += D(1) * weight;
-				weightsum += weight;
-			}
-
-			y = i + DSUM(0) / weightsum;
-			x = j + DSUM(1) / weightsum;
-
-			if (y > h-1)
-				y = h-1;
-			else
-				y = floor(y+0.5);
+// everything that depends only on the lines is computed once here, rather than once per pixel and line
+	prepared_lines lines(P, Q, Pprime, Qprime, p);
 
-			if (x > w-1)
-				x = w-1;
-			else
-				x = floor(x+0.5);
+// for each row of pixels X; with AVX, warp_row() computes four pixels at a time, see prepared_lines::warp_row()
+// for the tolerance against the scalar warp
+#pragma omp parallel if ((long) h * w * lines.size() > 65536)
+	{
+		vcl_vector<double> si(w), sj(w);
 
-			destination(i,j).r = source((int)y, (int)x).r;
-			destination(i,j).g = source((int)y, (int)x).g;
-			destination(i,j).b = source((int)y, (int)x).b;
-		}
+#pragma omp for schedule(static)
+		for (i=0; i < h; i++)
+			warp_row(source, lines, a, b, i, &si[0], &sj[0], destination);
 	}
 }
@@ -0,0 +1,111 @@
+#include "prepared_lines.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+prepared_lines::prepared_lines(
+			const vnl_matrix<double>& P, const vnl_matrix<double>& Q,
+			const vnl_matrix<double>& Pprime, const vnl_matrix<double>& Qprime,
+			double p
+			)
+{
+	int l;
+	int n = P.cols();
+
+	for (l=0; l < n; l++) {
+		double dx = Q(0,l) - P(0,l), dy = Q(1,l) - P(1,l);
+		double sdx = Qprime(0,l) - Pprime(0,l), sdy = Qprime(1,l) - Pprime(1,l);
+		double len2 = dx*dx + dy*dy;
+		double slen = vcl_sqrt(sdx*sdx + sdy*sdy);
+
+		if ((len2 <= 0.0) || (slen <= 0.0))
+			continue;
+
+		double len = vcl_sqrt(len2);
+
+		px_.push_back(P(0,l));
+		py_.push_back(P(1,l));
+		qx_.push_back(Q(0,l));
+		qy_.push_back(Q(1,l));
+		dx_.push_back(dx);
+		dy_.push_back(dy);
+		inv_len2_.push_back(1.0 / len2);
+		inv_len_.push_back(1.0 / len);
+
+		spx_.push_back(Pprime(0,l));
+		spy_.push_back(Pprime(1,l));
+		sdx_.push_back(sdx);
+		sdy_.push_back(sdy);
+		snx_.push_back(sdy / slen);
+		sny_.push_back(-sdx / slen);
+
+		strength_.push_back(vcl_pow(len, p));
+	}
+}
+
+void prepared_lines::warp_row(double x, double y0, int n, double a, double b, double* sx, double* sy) const
+{
+	int k = 0, l, m = size();
+
+#if defined(__AVX__)
+	const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0), sign = _mm256_set1_pd(-0.0);
+	const __m256d vx = _mm256_set1_pd(x), va = _mm256_set1_pd(a);
+
+	for (; k + 4 <= n; k += 4) {
+		__m256d y = _mm256_set_pd(y0 + k + 3, y0 + k + 2, y0 + k + 1, y0 + k);
+		__m256d dsum_x = zero, dsum_y = zero, weightsum = zero;
+
+		for (l=0; l < m; l++) {
+// x is shared by the four points, so the terms in x alone are scalar
+			double xp = x - px_[l], xq = x - qx_[l];
+			__m256d yp = _mm256_sub_pd(y, _mm256_set1_pd(py_[l]));
+			__m256d yq = _mm256_sub_pd(y, _mm256_set1_pd(qy_[l]));
+
+			__m256d u = _mm256_mul_pd(_mm256_add_pd(_mm256_set1_pd(xp * dx_[l]), _mm256_mul_pd(yp, _mm256_set1_pd(dy_[l]))),
+									  _mm256_set1_pd(inv_len2_[l]));
+			__m256d v = _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(xp * dy_[l]), _mm256_mul_pd(yp, _mm256_set1_pd(dx_[l]))),
+									  _mm256_set1_pd(inv_len_[l]));
+
+			__m256d wx = _mm256_add_pd(_mm256_add_pd(_mm256_set1_pd(spx_[l]), _mm256_mul_pd(u, _mm256_set1_pd(sdx_[l]))),
+									   _mm256_mul_pd(v, _mm256_set1_pd(snx_[l])));
+			__m256d wy = _mm256_add_pd(_mm256_add_pd(_mm256_set1_pd(spy_[l]), _mm256_mul_pd(u, _mm256_set1_pd(sdy_[l]))),
+									   _mm256_mul_pd(v, _mm256_set1_pd(sny_[l])));
+
+// |v| inside the extent of the line, the distance to P before it and to Q after it
+			__m256d dist = _mm256_andnot_pd(sign, v);
+			dist = _mm256_blendv_pd(dist, _mm256_sqrt_pd(_mm256_add_pd(_mm256_set1_pd(xq*xq), _mm256_mul_pd(yq, yq))),
+									_mm256_cmp_pd(u, one, _CMP_GT_OQ));
+			dist = _mm256_blendv_pd(dist, _mm256_sqrt_pd(_mm256_add_pd(_mm256_set1_pd(xp*xp), _mm256_mul_pd(yp, yp))),
+									_mm256_cmp_pd(u, zero, _CMP_LT_OQ));
+
+			__m256d weight = _mm256_div_pd(_mm256_set1_pd(strength_[l]), _mm256_add_pd(va, dist));
+			if (b == 2.0)
+				weight = _mm256_mul_pd(weight, weight);
+			else if (b != 1.0) {
+				double w[4];
+				_mm256_storeu_pd(w, weight);
+				w[0] = vcl_pow(w[0], b);
+				w[1] = vcl_pow(w[1], b);
+				w[2] = vcl_pow(w[2], b);
+				w[3] = vcl_pow(w[3], b);
+				weight = _mm256_loadu_pd(w);
+			}
+
+			dsum_x = _mm256_add_pd(dsum_x, _mm256_mul_pd(_mm256_sub_pd(wx, vx), weight));
+			dsum_y = _mm256_add_pd(dsum_y, _mm256_mul_pd(_mm256_sub_pd(wy, y), weight));
+			weightsum = _mm256_add_pd(weightsum, weight);
+		}
+
+// the points with weightsum <= 0 stay in place, as in warp()
+		__m256d moved = _mm256_cmp_pd(weightsum, zero, _CMP_NLE_UQ);
+		_mm256_storeu_pd(sx + k, _mm256_blendv_pd(vx, _mm256_add_pd(vx, _mm256_div_pd(dsum_x, weightsum)), moved));
+		_mm256_storeu_pd(sy + k, _mm256_blendv_pd(y, _mm256_add_pd(y, _mm256_div_pd(dsum_y, weightsum)), moved));
+	}
+#endif
+	for (; k < n; k++)
+		if (!warp(x, y0 + k, a, b, sx[k], sy[k])) {
+			sx[k] = x;
+			sy[k] = y0 + k;
+		}
+}
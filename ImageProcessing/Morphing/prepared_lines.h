@@ -0,0 +1,90 @@
+#ifndef PREPARED_LINES_H
+#define PREPARED_LINES_H
+
+#include <vnl/vnl_matrix.h>
+#include <vcl_vector.h>
+#include <vcl_cmath.h>
+
+// The line pairs of one Beier-Neely field warp, with everything that depends only on the lines computed once
+//
+// For a destination line PQ and its source line P'Q', the warp of a point X is
+//
+//	u  = (X - P).(Q - P) / |Q - P|^2
+//	v  = (X - P).perp(Q - P) / |Q - P|
+//	X' = P' + u (Q' - P') + v perp(Q' - P') / |Q' - P'|
+//
+// weighted by (|Q - P|^p / (a + dist))^b. The per-line terms are stored as structure-of-arrays, one array per
+// term, so that the per-pixel reduction over the lines streams through contiguous memory. Lines of length zero
+// carry no direction and are dropped.
+class prepared_lines {
+public:
+// P, Q, Pprime, Qprime are 2 x n matrices holding one line end point per column, as returned by linepairs::get()
+	prepared_lines(
+				const vnl_matrix<double>& P, const vnl_matrix<double>& Q,
+				const vnl_matrix<double>& Pprime, const vnl_matrix<double>& Qprime,
+				double p
+				);
+
+	int size() const { return px_.size(); }
+
+// the point of the source that maps to (x, y); false if there are no lines
+	inline bool warp(double x, double y, double a, double b, double& sx, double& sy) const;
+
+// the points of the source that map to (x, y0), (x, y0 + 1), ..., (x, y0 + n - 1); points that no line moves map
+// to themselves. With AVX, four points are warped at a time: every lane runs the same operations, in the same
+// order, as warp(), so the result is identical unless the compiler contracts the scalar arithmetic of warp() into
+// fused multiply-adds (eg. with -mfma), which may move a point by about 1e-12 and, at a rounding boundary, change
+// the resampled pixel by one.
+	void warp_row(double x, double y0, int n, double a, double b, double* sx, double* sy) const;
+
+private:
+// destination lines: P, Q, Q - P, 1/|Q - P|^2, 1/|Q - P|
+	vcl_vector<double> px_, py_, qx_, qy_, dx_, dy_, inv_len2_, inv_len_;
+// source lines: P', Q' - P' and perp(Q' - P') / |Q' - P'|
+	vcl_vector<double> spx_, spy_, sdx_, sdy_, snx_, sny_;
+// |Q - P|^p
+	vcl_vector<double> strength_;
+};
+
+inline bool prepared_lines::warp(double x, double y, double a, double b, double& sx, double& sy) const
+{
+	int n = size();
+	double dsum_x = 0, dsum_y = 0, weightsum = 0;
+
+	for (int l=0; l < n; l++) {
+		double xp = x - px_[l], yp = y - py_[l];
+		double u = (xp * dx_[l] + yp * dy_[l]) * inv_len2_[l];
+		double v = (xp * dy_[l] - yp * dx_[l]) * inv_len_[l];
+
+		double wx = spx_[l] + u * sdx_[l] + v * snx_[l];
+		double wy = spy_[l] + u * sdy_[l] + v * sny_[l];
+
+		double dist;
+		if (u < 0.0)
+			dist = vcl_sqrt(xp*xp + yp*yp);
+		else if (u > 1.0)
+			dist = vcl_sqrt((x - qx_[l])*(x - qx_[l]) + (y - qy_[l])*(y - qy_[l]));
+		else
+			dist = vcl_fabs(v);
+
+// the common weight exponents avoid the pow() call
+		double weight = strength_[l] / (a + dist);
+		if (b == 2.0)
+			weight *= weight;
+		else if (b != 1.0)
+			weight = vcl_pow(weight, b);
+
+		dsum_x += (wx - x) * weight;
+		dsum_y += (wy - y) * weight;
+		weightsum += weight;
+	}
+
+	if (weightsum <= 0.0)
+		return false;
+
+	sx = x + dsum_x / weightsum;
+	sy = y + dsum_y / weightsum;
+	return true;
+}
+
+#endif